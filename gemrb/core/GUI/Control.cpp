@@ -107,6 +107,7 @@ void Control::Draw(unsigned short x, unsigned short y)
 	video->SetScreenClip(&drawFrame);
 	DrawInternal(drawFrame);
 	video->SetScreenClip(&clip);
+	video->InvalidateRegion(drawFrame);
 	Changed = false; // set *after* calling DrawInternal
 }
 
@@ -191,6 +191,7 @@ Interface::Interface()
 	TouchScrollAreas = false;
 	UseSoftKeyboard = false;
 	KeepCache = false;
+	PrecacheArchives = false;
 	NumFingInfo = 2;
 	NumFingKboard = 3;
 	NumFingScroll = 2;
@@ -986,12 +987,16 @@ void Interface::Main()
 
 	Font* fps = GetTextFont();
 	// TODO: if we ever want to support dynamic resolution changes this will break
-	const Region fpsRgn( 0, Height - 30, 100, 30 );
-	wchar_t fpsstring[20] = {L"???.??? fps"};
+	const Region fpsRgn( 0, Height - 30, 160, 30 );
+	wchar_t fpsstring[32] = {L"???.??? fps"};
+	const Region pixelRgn( 0, Height - 60, 100, 30 );
+	wchar_t pixelstring[20] = {L"0 px"};
 
 	unsigned long frame = 0, time, timebase;
 	timebase = GetTicks();
 	double frames;
+	// time spent updating and drawing, without presenting and the frame limiter
+	std::chrono::steady_clock::duration drawTime(0);
 	Palette* palette = new Palette( ColorWhite, ColorBlack );
 	do {
 		//don't change script when quitting is pending
@@ -1005,20 +1010,33 @@ void Interface::Main()
 		}
 		HandleGUIBehaviour();
 
+		std::chrono::steady_clock::time_point drawStart = std::chrono::steady_clock::now();
 		GameLoop();
 		DrawWindows(true);
 		if (DrawFPS) {
+			drawTime += std::chrono::steady_clock::now() - drawStart;
 			frame++;
 			time = GetTicks();
 			if (time - timebase > 1000) {
 				frames = ( frame * 1000.0 / ( time - timebase ) );
+				double drawMs = std::chrono::duration<double, std::milli>(drawTime).count() / frame;
 				timebase = time;
 				frame = 0;
-				swprintf(fpsstring, sizeof(fpsstring)/sizeof(fpsstring[0]), L"%.3f fps", frames);
+				drawTime = std::chrono::steady_clock::duration(0);
+				swprintf(fpsstring, sizeof(fpsstring)/sizeof(fpsstring[0]), L"%.3f fps, %.2f ms", frames, drawMs);
 			}
 			video->DrawRect( fpsRgn, ColorBlack );
 			fps->Print( fpsRgn, String(fpsstring), palette,
 					   IE_FONT_ALIGN_LEFT | IE_FONT_ALIGN_MIDDLE | IE_FONT_SINGLE_LINE );
+			video->InvalidateRegion( fpsRgn );
+		}
+		if (DrawDirtyRects) {
+			// pixels repainted for the previous frame, this one isn't presented yet
+			swprintf(pixelstring, sizeof(pixelstring)/sizeof(pixelstring[0]), L"%lu px", video->GetDrawnPixels());
+			video->DrawRect( pixelRgn, ColorBlack );
+			fps->Print( pixelRgn, String(pixelstring), palette,
+					   IE_FONT_ALIGN_LEFT | IE_FONT_ALIGN_MIDDLE | IE_FONT_SINGLE_LINE );
+			video->InvalidateRegion( pixelRgn );
 		}
 		if (TickHook)
 			TickHook();
@@ -1299,6 +1317,7 @@ int Interface::Init(InterfaceConfig* config)
 	CONFIG_INT("CaseSensitive", CaseSensitive =);
 	CONFIG_INT("DoubleClickDelay", evntmgr->SetDCDelay);
 	CONFIG_INT("DrawFPS", DrawFPS = );
+	CONFIG_INT("DrawDirtyRects", DrawDirtyRects = );
 	CONFIG_INT("EnableCheatKeys", EnableCheatKeys);
 	CONFIG_INT("EndianSwitch", DataStream::SetEndianSwitch);
 	CONFIG_INT("FogOfWar", FogOfWar = );
@@ -1313,10 +1332,13 @@ int Interface::Init(InterfaceConfig* config)
 	MaxPartySize = std::min(std::max(1, MaxPartySize), 10);
 	vars->SetAt("MaxPartySize", MaxPartySize); // for simple GUIScript access
 	CONFIG_INT("MultipleQuickSaves", MultipleQuickSaves = );
+	CONFIG_INT("PartialScreenUpdates", PartialScreenUpdates = );
+	CONFIG_INT("PrecacheArchives", PrecacheArchives = );
 	CONFIG_INT("RepeatKeyDelay", evntmgr->SetRKDelay);
 	CONFIG_INT("SaveAsOriginal", SaveAsOriginal = );
 	CONFIG_INT("ScriptDebugMode", SetScriptDebugMode);
 	CONFIG_INT("SkipIntroVideos", SkipIntroVideos = );
+	CONFIG_INT("TileCache", TileCache = );
 	CONFIG_INT("TooltipDelay", TooltipDelay = );
 	CONFIG_INT("Width", Width = );
 	CONFIG_INT("IgnoreOriginalINI", IgnoreOriginalINI = );
@@ -2327,6 +2349,7 @@ static const char *game_flags[GF_COUNT+1]={
 		"FixedMoraleOpcode",  //78GF_FIXED_MORALE_OPCODE
 		"Happiness",          //79GF_HAPPINESS
 		"EfficientORTrigger", //80GF_EFFICIENT_OR
+		"SampledLines",       //81GF_SAMPLED_LINES
 		NULL                  //for our own safety, this marks the end of the pole
 };
 
@@ -2967,6 +2990,10 @@ int Interface::SetVisible(unsigned short WindowIndex, int visible)
 			if (win->WindowID==65535) {
 				video->SetViewport( 0,0,0,0 );
 			}
+			if (visible == WINDOW_INVISIBLE) {
+				video->InvalidateRegion(Region(win->XPos, win->YPos, win->Width, win->Height));
+				RedrawAll();
+			}
 			evntmgr->DelWindow( win );
 			break;
 
@@ -3159,6 +3186,7 @@ void Interface::DrawWindows(bool allow_delete)
 				shieldColor.a = 0xff;
 			}
 			video->DrawRect( Region( 0, 0, Width, Height ), shieldColor );
+			video->InvalidateScreen();
 			video->TakeBackgroundBuffer();
 			RedrawAll(); // wont actually have any effect until the modal window is dismissed.
 			modalShield = true;
@@ -3191,6 +3219,9 @@ void Interface::DrawWindows(bool allow_delete)
 		if (win != NULL) {
 			if (win->Visible == WINDOW_INVALID) {
 				if (allow_delete) {
+					// what was under it has to be painted and presented again
+					video->InvalidateRegion(Region(win->XPos, win->YPos, win->Width, win->Height));
+					RedrawAll();
 					topwin.erase(topwin.begin()+i);
 					evntmgr->DelWindow( win );
 					delete win;
@@ -3272,10 +3303,13 @@ void Interface::DrawTooltip ()
 	int x = strx + ((strw - w) / 2);
 
 	Region clip = Region( x, y, w, h );
+	video->InvalidateRegion(clip);
 	if (TooltipBack) {
 		video->BlitSprite( TooltipBack[0], x + TooltipMargin - (TooltipBack[0]->Width - w) / 2, y, true, &clip );
 		video->BlitSprite( TooltipBack[1], x, y, true );
 		video->BlitSprite( TooltipBack[2], x + w, y, true );
+		video->InvalidateRegion(Region(x - TooltipBack[1]->XPos, y - TooltipBack[1]->YPos, w1, TooltipBack[1]->Height));
+		video->InvalidateRegion(Region(x + w - TooltipBack[2]->XPos, y - TooltipBack[2]->YPos, w2, TooltipBack[2]->Height));
 	}
 
 	if (TooltipBack) {
@@ -3384,6 +3418,9 @@ void Interface::RequestPasting(const String & string)
 void Interface::PopupConsole()
 {
 	ConsolePopped = !ConsolePopped;
+	if (!ConsolePopped) {
+		video->InvalidateRegion(Region(console->XPos, console->YPos, console->Width, console->Height));
+	}
 	RedrawAll();
 }
 
@@ -826,13 +826,16 @@ public:
 	unsigned int TooltipDelay;
 	int IgnoreOriginalINI;
 	unsigned int FogOfWar;
-	bool CaseSensitive = true, SkipIntroVideos = false, DrawFPS = false;
+	bool CaseSensitive = true, SkipIntroVideos = false, DrawFPS = false, DrawDirtyRects = false;
+	bool PartialScreenUpdates = true;
+	bool TileCache = true;
 	bool TouchScrollAreas, UseSoftKeyboard;
 	unsigned short NumFingScroll, NumFingKboard, NumFingInfo;
 	int MouseFeedback;
 	int GUIEnhancements;
 	int MaxPartySize;
 	bool KeepCache;
+	bool PrecacheArchives;
 	bool MultipleQuickSaves;
 	bool UseCorruptedHack;
 	int FeedbackLevel;
@@ -54,15 +54,33 @@
 #include "Scriptable/InfoPoint.h"
 #include "System/StringBuffer.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cassert>
+#include <cstring>
 #include <limits>
+#include <thread>
 
 namespace GemRB {
 
 #define YESNO(x) ( (x)?"Yes":"No")
 
 #define ANI_PRI_BACKGROUND	-9999
+// side of an actor grid bucket in pixels
+#define ACTOR_GRID_CELL 128
+// side of a searchmap square counted in ActorMarks
+#define ACTOR_MARK_BLOCK 8
+// upper bound for the worker threads finding the requested paths
+#define MAX_PATH_THREADS 4
+// movers heading within this many searchmap cells of each other share a flow field
+#define FLOW_GROUP_RADIUS 8
+// fewer movers are not worth building a flow field for
+#define MIN_FLOW_MOVERS 3
+// how long a flow field is kept for later movers, in game ticks (ms)
+#define FLOW_FIELD_TIME 2000
+#define MAX_FLOW_FIELDS 4
+// the sprite cover cache is emptied when it grows past this many entries
+#define MAX_COVER_CACHE 256
 
 // TODO: fix this hardcoded resource reference
 static ieResRef PortalResRef={"EF03TPR3"};
@@ -76,10 +94,13 @@ static unsigned char Passable[16] = {
 	4, 1, 1, 1, 1, 1, 1, 1, 0, 1, 8, 0, 0, 0, 3, 1
 };
 static Point **VisibilityMasks=NULL;
+// CircleSizeFor of the offsets within MAX_CIRCLESIZE - 2, row major
+static std::vector<unsigned char> CircleSizes;
 
 static bool PathFinderInited = false;
 static Variables Spawns;
 static int LargeFog;
+static bool SampledLines = false;
 static TerrainSounds *terrainsounds=NULL;
 static int tsndcount = -1;
 
@@ -217,11 +238,33 @@ static void InitSpawnGroups()
 	}
 }
 
+// the smallest size for which the GetBlockedInRadius circle covers
+// the searchmap offset (dx, dy), MAX_CIRCLESIZE + 1 if none does
+static unsigned char CircleSizeFor(unsigned int dx, unsigned int dy)
+{
+	for (unsigned int size = 2; size <= MAX_CIRCLESIZE; size++) {
+		unsigned int r = (size - 2) * (size - 2) + 1;
+		if (size == 2) r = 0;
+		if (dx <= size - 2 && dy <= size - 2 && dx * dx + dy * dy <= r) {
+			return (unsigned char) size;
+		}
+	}
+	return (unsigned char) (MAX_CIRCLESIZE + 1);
+}
+
 //Preload the searchmap configuration
 static void InitPathFinder()
 {
 	PathFinderInited = true;
+	const unsigned int reach = MAX_CIRCLESIZE - 2;
+	CircleSizes.resize((reach + 1) * (reach + 1));
+	for (unsigned int dy = 0; dy <= reach; dy++) {
+		for (unsigned int dx = 0; dx <= reach; dx++) {
+			CircleSizes[dy * (reach + 1) + dx] = CircleSizeFor(dx, dy);
+		}
+	}
 	tsndcount = 0;
+	SampledLines = core->HasFeature(GF_SAMPLED_LINES);
 	AutoTable tm("pathfind");
 
 	if (!tm) {
@@ -362,17 +405,41 @@ Map::Map(void)
 	Rain = Snow = Fog = Lightning = DayNight = 0;
 	trackString = trackFlag = trackDiff = 0;
 	Width = Height = 0;
+	actorGridWidth = actorGridHeight = 0;
+	actorGridMaxSize = 0;
+	actorGridOrder = 0;
+	losRays = 0;
+	losMemoHits = 0;
+	coversBuilt = 0;
+	coverCacheHits = 0;
+	fogGeneration = 1;
+	fogStamp = 0;
+	terrainGeneration = 0;
+	pathWorkers = NULL;
+	ResizeActorGrid();
 	RestHeader.Difficulty = RestHeader.CreatureNum = RestHeader.Maximum = RestHeader.Enabled = 0;
 	RestHeader.DayChance = RestHeader.NightChance = RestHeader.sduration = RestHeader.rwdist = RestHeader.owdist = 0;
 	SongHeader.reverbID = SongHeader.MainDayAmbientVol = SongHeader.MainNightAmbientVol = 0;
 	reverb = NULL;
 	MaterialMap = NULL;
+	ImpassableClearance = NULL;
+	TerrainClearance = NULL;
+	ActorMarks = NULL;
+	ActorMarksWidth = 0;
 }
 
 Map::~Map(void)
 {
+	DropPathBatch();
+	delete pathWorkers;
 	free( SrchMap );
 	free( MaterialMap );
+	free( ImpassableClearance );
+	free( TerrainClearance );
+	free( ActorMarks );
+	for (FlowField *field : flowFields) {
+		delete field;
+	}
 
 	//close the current container if it was owned by this map, this avoids a crash
 	Container *c = core->GetCurrentContainer();
@@ -455,12 +522,14 @@ void Map::ChangeTileMap(Image* lm, Sprite2D* sm)
 void Map::AddTileMap(TileMap* tm, Image* lm, Bitmap* sr, Sprite2D* sm, Bitmap* hm)
 {
 	// CHECKME: leaks? Should the old TMap, LightMap, etc... be freed?
+	DropPathBatch();
 	TMap = tm;
 	LightMap = lm;
 	HeightMap = hm;
 	SmallMap = sm;
 	Width = (unsigned int) (TMap->XCellCount * 4);
 	Height = (unsigned int) (( TMap->YCellCount * 64 + 63) / 12);
+	ResizeActorGrid();
 	//Internal Searchmap
 	int y = sr->GetHeight();
 	SrchMap = (unsigned short *) calloc(Width * Height, sizeof(unsigned short));
@@ -477,6 +546,30 @@ void Map::AddTileMap(TileMap* tm, Image* lm, Bitmap* sr, Sprite2D* sm, Bitmap* h
 
 	//delete the original searchmap
 	delete sr;
+	losMemo.clear();
+	fogContributions.clear();
+
+	free(ImpassableClearance);
+	free(TerrainClearance);
+	free(ActorMarks);
+	ImpassableClearance = (unsigned char *) malloc(Width * Height);
+	TerrainClearance = (unsigned char *) malloc(Width * Height);
+	UpdateClearance(0, 0, Width - 1, Height - 1);
+	ActorMarksWidth = (Width + ACTOR_MARK_BLOCK - 1) / ACTOR_MARK_BLOCK;
+	ActorMarks = (unsigned char *) calloc(ActorMarksWidth * ((Height + ACTOR_MARK_BLOCK - 1) / ACTOR_MARK_BLOCK), 1);
+	searchmapView.cells = SrchMap;
+	searchmapView.impassableClearance = ImpassableClearance;
+	searchmapView.terrainClearance = TerrainClearance;
+	searchmapView.actorMarks = ActorMarks;
+	searchmapView.width = Width;
+	searchmapView.height = Height;
+	searchmapView.actorMarksWidth = ActorMarksWidth;
+	searchmapView.sampledLines = SampledLines;
+	pathAbstractions.clear();
+	for (FlowField *field : flowFields) {
+		delete field;
+	}
+	flowFields.clear();
 }
 void Map::AutoLockDoors() const
 {
@@ -660,12 +753,20 @@ void Map::UpdateScripts()
 {
 	bool has_pcs = false;
 	for (auto actor : actors) {
+		// catch any position (or size) change that bypassed UpdateActorGrid
+		UpdateActorGrid(actor);
+		actor->ClearPathFailed();
 		if (actor->InParty) {
 			has_pcs = true;
-			break;
 		}
 	}
 
+	// line of sight is only memoized within a tick
+	losMemo.clear();
+
+	// the new paths requested during the last update
+	ResolvePathRequests();
+
 	GenerateQueues();
 	SortQueues();
 
@@ -904,6 +1005,363 @@ void Map::ClearSearchMapFor(const Movable *actor) {
 	}
 }
 
+// lifts several actors off the searchmap at once, the other actors
+// around them get their blocked areas back
+void Map::ClearSearchMapFor(const std::vector<Actor *> &movers)
+{
+	std::vector<Actor *> nearActors;
+	for (const Actor *actor : movers) {
+		std::vector<Actor *> near = GetAllActorsInRadius(actor->Pos, GA_NO_SELF|GA_NO_DEAD|GA_NO_LOS|GA_NO_UNSCHEDULED, MAX_CIRCLE_SIZE*3, actor);
+		nearActors.insert(nearActors.end(), near.begin(), near.end());
+		BlockSearchMap(actor->Pos, actor->size, PATH_MAP_UNMARKED);
+	}
+
+	for (const Actor *neighbour : nearActors) {
+		if (neighbour->BlocksSearchMap() && std::find(movers.begin(), movers.end(), neighbour) == movers.end()) {
+			BlockSearchMap(neighbour->Pos, neighbour->size, neighbour->IsPartyMember() ? PATH_MAP_PC : PATH_MAP_NPC);
+		}
+	}
+}
+
+void Map::RequestPath(const Actor *actor)
+{
+	ieDword id = actor->GetGlobalID();
+	if (std::find(pathRequests.begin(), pathRequests.end(), id) != pathRequests.end()) {
+		return;
+	}
+	// already being searched
+	if (pathBatch.running) {
+		for (const PathSearch &search : pathBatch.searches) {
+			if (search.actorID == id) return;
+		}
+	}
+	pathRequests.push_back(id);
+}
+
+// the searches of the path workers, on the snapshot of their batch
+class Map::SnapshotPathContext : public PathContext {
+public:
+	SnapshotPathContext(const PathBatch &batch, PathSearch &search)
+	: batch(batch), search(search)
+	{
+	}
+
+	const SearchmapView &GetSearchmap() const override { return batch.snapshot.view; }
+	bool IsActorInTheWay(const Point &p, bool actorsAreBlocking) const override;
+	const PathAbstraction *GetPathAbstraction(unsigned int size) const override
+	{
+		size = Clamp(size, 2u, MAX_CIRCLESIZE);
+		// refreshed when the batch was handed out, never built or updated here
+		assert(size < batch.abstractions.size() && batch.abstractions[size] && !batch.abstractions[size]->IsDirty());
+		return batch.abstractions[size].get();
+	}
+	double GetStepFactor() const override { return search.stepFactor; }
+	const char *GetCallerName() const override { return search.name.c_str(); }
+	void LogDebug(const char *owner, const StringBuffer &message) const override
+	{
+		search.messages.push_back(std::make_pair(std::string(owner), message.get()));
+	}
+
+private:
+	const PathBatch &batch;
+	PathSearch &search;
+};
+
+// positions outside the map end up in the border buckets
+static inline unsigned int ActorGridIndex(long coord, unsigned int count)
+{
+	if (coord < 0) return 0;
+	unsigned int idx = (unsigned int) (coord / ACTOR_GRID_CELL);
+	return idx < count ? idx : count - 1;
+}
+
+// Selectable::IsOver for a snapshotted actor
+static bool IsOverActor(const SearchActor &actor, const Point &p)
+{
+	int csize = std::max(actor.size, 2u);
+	int dx = p.x - actor.pos.x;
+	int dy = p.y - actor.pos.y;
+	if (dx < -(csize - 1) * 16 || dx > (csize - 1) * 16) return false;
+	if (dy < -(csize - 1) * 12 || dy > (csize - 1) * 12) return false;
+	return 9 * dx * dx + 16 * dy * dy <= 48 * 48 * (csize - 1) * (csize - 1);
+}
+
+// like the GetActor check of the live searches: the first actor in the list standing on p
+bool Map::SnapshotPathContext::IsActorInTheWay(const Point &p, bool actorsAreBlocking) const
+{
+	const SearchmapSnapshot &snapshot = batch.snapshot;
+	long reach = (std::max(snapshot.actorMaxSize, 2u) - 1) * 16;
+	unsigned int x1 = ActorGridIndex(p.x - reach, snapshot.actorGridWidth);
+	unsigned int x2 = ActorGridIndex(p.x + reach, snapshot.actorGridWidth);
+	unsigned int y1 = ActorGridIndex(p.y - reach, snapshot.actorGridHeight);
+	unsigned int y2 = ActorGridIndex(p.y + reach, snapshot.actorGridHeight);
+	unsigned int first = std::numeric_limits<unsigned int>::max();
+	for (unsigned int y = y1; y <= y2; y++) {
+		for (unsigned int x = x1; x <= x2; x++) {
+			for (unsigned int idx : snapshot.actorGrid[y * snapshot.actorGridWidth + x]) {
+				if (idx < first && IsOverActor(snapshot.actors[idx], p)) {
+					first = idx;
+				}
+			}
+		}
+	}
+	if (first == std::numeric_limits<unsigned int>::max()) {
+		return false;
+	}
+	const SearchActor &actor = snapshot.actors[first];
+	return actor.id != search.actorID && (actorsAreBlocking || !actor.bumpable);
+}
+
+// Hands out the finished searches and the new requests of the last update.
+// The searches run on the path workers between the updates, over a snapshot
+// of the area, so a mover waits exactly one tick for its path, standing still
+// (see Movable::SetPathPending). The results are handed out in request order.
+void Map::ResolvePathRequests()
+{
+	if (pathBatch.running) {
+		// always the next update, whatever the thread timing, so games replay the same
+		pathWorkers->Wait();
+		FinishPathBatch();
+	}
+	if (pathRequests.empty()) return;
+
+	std::vector<Actor *> movers;
+	for (ieDword id : pathRequests) {
+		Actor *actor = GetActorByGlobalID(id);
+		if (!actor) continue;
+		// a WalkTo has prepared its search already
+		if (actor->IsPathPending() || actor->BeginNewPath()) {
+			movers.push_back(actor);
+		} else {
+			actor->SetPathPending(false);
+		}
+	}
+	pathRequests.clear();
+	if (!movers.empty()) {
+		StartPathBatch(movers);
+	}
+}
+
+void Map::StartPathBatch(const std::vector<Actor *> &movers)
+{
+	std::vector<FlowField *> fields(movers.size(), nullptr);
+	AssignFlowFields(movers, fields);
+
+	pathBatch.abstractions.clear();
+	pathBatch.searches.resize(movers.size());
+	for (size_t i = 0; i < movers.size(); i++) {
+		Actor *actor = movers[i];
+		PathSearch &search = pathBatch.searches[i];
+		search.actorID = actor->GetGlobalID();
+		search.name = actor->GetName(0);
+		search.start = actor->Pos;
+		search.goal = actor->Destination;
+		search.dest = GetPathDestination(actor->Destination, actor->size);
+		search.size = actor->size;
+		search.minDistance = actor->GetPathfindingDistance();
+		search.canBump = actor->ValidTarget(GA_CAN_BUMP);
+		search.stepFactor = StepFactor(actor);
+		search.field = fields[i];
+		search.path = nullptr;
+		search.messages.clear();
+
+		// build or update the cluster graphs now, the workers only read them
+		unsigned int size = Clamp((unsigned int) actor->size, 2u, MAX_CIRCLESIZE);
+		GetPathAbstraction(size);
+		if (pathBatch.abstractions.size() <= size) {
+			pathBatch.abstractions.resize(size + 1);
+		}
+		pathBatch.abstractions[size] = pathAbstractions[size];
+		actor->SetPathPending(true);
+	}
+
+	// what WalkTo does before its search, but only for the snapshot: the
+	// movers keep their place on the live searchmap while they wait
+	std::vector<Actor *> blocking;
+	for (Actor *actor : movers) {
+		if (actor->BlocksSearchMap()) {
+			blocking.push_back(actor);
+		}
+	}
+	ClearSearchMapFor(blocking);
+	SnapshotSearchmap();
+	for (const Actor *actor : blocking) {
+		BlockSearchMap(actor->Pos, actor->size, actor->IsPartyMember() ? PATH_MAP_PC : PATH_MAP_NPC);
+	}
+
+	if (!pathWorkers) {
+		size_t threadCount = std::thread::hardware_concurrency();
+		// leave a core to the main thread
+		threadCount = Clamp<size_t>(threadCount ? threadCount - 1 : 1, 1, MAX_PATH_THREADS);
+		pathWorkers = new PathWorkers(threadCount);
+	}
+	pathBatch.running = true;
+	pathWorkers->Start(pathBatch.searches.size(), [this](size_t i, PathWorkspace &ws) {
+		PathSearch &search = pathBatch.searches[i];
+		SnapshotPathContext ctx(pathBatch, search);
+		if (search.field) {
+			search.path = FindFlowPath(search.start, search.goal, *search.field, PF_SIGHT|PF_ACTORS_ARE_BLOCKING, ctx, ws);
+			if (search.path) return;
+		}
+		search.path = FindPath(search.start, search.goal, search.dest, search.size, search.minDistance, PF_SIGHT|PF_ACTORS_ARE_BLOCKING, ctx, ws);
+		if (!search.path && search.canBump) {
+			StringBuffer buffer;
+			buffer.appendFormatted("%s re-pathing ignoring actors", search.name.c_str());
+			ctx.LogDebug("WalkTo", buffer);
+			search.path = FindPath(search.start, search.goal, search.dest, search.size, search.minDistance, PF_SIGHT, ctx, ws);
+		}
+	});
+}
+
+// copies what the searches read, reusing the buffers of the last batch
+void Map::SnapshotSearchmap()
+{
+	SearchmapSnapshot &snapshot = pathBatch.snapshot;
+	size_t cells = Width * Height;
+	snapshot.cells.assign(SrchMap, SrchMap + cells);
+	snapshot.impassableClearance.assign(ImpassableClearance, ImpassableClearance + cells);
+	snapshot.terrainClearance.assign(TerrainClearance, TerrainClearance + cells);
+	size_t marks = ActorMarksWidth * ((Height + ACTOR_MARK_BLOCK - 1) / ACTOR_MARK_BLOCK);
+	snapshot.actorMarks.assign(ActorMarks, ActorMarks + marks);
+	snapshot.view = searchmapView;
+	snapshot.view.cells = snapshot.cells.data();
+	snapshot.view.impassableClearance = snapshot.impassableClearance.data();
+	snapshot.view.terrainClearance = snapshot.terrainClearance.data();
+	snapshot.view.actorMarks = snapshot.actorMarks.data();
+
+	snapshot.actors.clear();
+	snapshot.actorGridWidth = actorGridWidth;
+	snapshot.actorGridHeight = actorGridHeight;
+	snapshot.actorGrid.resize(actorGridWidth * actorGridHeight);
+	for (std::vector<unsigned int> &bucket : snapshot.actorGrid) {
+		bucket.clear();
+	}
+	snapshot.actorMaxSize = 0;
+	for (const Actor *actor : actors) {
+		if (!actor->ValidTarget(GA_NO_DEAD|GA_NO_UNSCHEDULED)) continue;
+		SearchActor entry;
+		entry.pos = actor->Pos;
+		entry.size = actor->size;
+		entry.id = actor->GetGlobalID();
+		entry.bumpable = actor->ValidTarget(GA_ONLY_BUMPABLE);
+		unsigned int x = ActorGridIndex(entry.pos.x, actorGridWidth);
+		unsigned int y = ActorGridIndex(entry.pos.y, actorGridHeight);
+		snapshot.actorGrid[y * actorGridWidth + x].push_back(snapshot.actors.size());
+		snapshot.actors.push_back(entry);
+		snapshot.actorMaxSize = std::max(snapshot.actorMaxSize, entry.size);
+	}
+}
+
+// what the searches of the path workers had to say, now on the main thread
+static void LogPathSearch(const PathSearch &search)
+{
+	for (const auto &message : search.messages) {
+		Log(DEBUG, message.first.c_str(), "%s", message.second.c_str());
+	}
+}
+
+void Map::FinishPathBatch()
+{
+	pathBatch.running = false;
+	for (PathSearch &search : pathBatch.searches) {
+		LogPathSearch(search);
+		Actor *actor = GetActorByGlobalID(search.actorID);
+		// a new walk, a stop or leaving the area made the result moot
+		if (!actor || !actor->IsPathPending()) {
+			delete search.path;
+			continue;
+		}
+		if (actor->Destination != search.goal || actor->GetPathfindingDistance() != (int) search.minDistance) {
+			delete search.path;
+			RequestPath(actor);
+			continue;
+		}
+		actor->FinishNewPath(search.path);
+	}
+	pathBatch.searches.clear();
+	pathBatch.abstractions.clear();
+}
+
+// waits for the workers and throws their results away, before the map
+// changes what they read (or goes away)
+void Map::DropPathBatch()
+{
+	if (!pathBatch.running) return;
+	pathWorkers->Wait();
+	pathBatch.running = false;
+	for (PathSearch &search : pathBatch.searches) {
+		LogPathSearch(search);
+		delete search.path;
+		Actor *actor = GetActorByGlobalID(search.actorID);
+		if (actor && actor->IsPathPending()) {
+			RequestPath(actor);
+		}
+	}
+	pathBatch.searches.clear();
+	pathBatch.abstractions.clear();
+}
+
+// Movers with the same size heading to about the same place (a party move
+// in formation, a group of monsters sent to one spot) get a shared flow
+// field; so do later movers, while a recent field for their goal is kept
+void Map::AssignFlowFields(const std::vector<Actor *> &movers, std::vector<FlowField *> &fields)
+{
+	ieDword now = core->GetGame()->Ticks;
+	for (size_t i = flowFields.size(); i--; ) {
+		const FlowField *field = flowFields[i];
+		if (now - field->GetTime() > FLOW_FIELD_TIME || field->GetGeneration() != terrainGeneration || i + MAX_FLOW_FIELDS < flowFields.size()) {
+			delete field;
+			flowFields.erase(flowFields.begin() + i);
+		}
+	}
+
+	// only the plain moves, FindPath handles the approaches and the blocked destinations
+	std::vector<bool> eligible(movers.size());
+	for (size_t i = 0; i < movers.size(); i++) {
+		const Actor *actor = movers[i];
+		eligible[i] = actor->GetPathfindingDistance() <= (int) actor->size &&
+			(GetBlockedInRadius(actor->Destination.x, actor->Destination.y, actor->size) & PATH_MAP_PASSABLE);
+	}
+
+	std::vector<size_t> group;
+	for (size_t i = 0; i < movers.size(); i++) {
+		if (!eligible[i] || fields[i]) continue;
+		int size = movers[i]->size;
+		SearchmapPoint goal(movers[i]->Destination.x / 16, movers[i]->Destination.y / 12);
+		FlowField *field = nullptr;
+		for (FlowField *cached : flowFields) {
+			const SearchmapPoint &cachedGoal = cached->GetGoal();
+			if (cached->GetSize() == (unsigned int) size && std::abs(cachedGoal.x - goal.x) <= FLOW_GROUP_RADIUS && std::abs(cachedGoal.y - goal.y) <= FLOW_GROUP_RADIUS) {
+				field = cached;
+				goal = cachedGoal;
+				break;
+			}
+		}
+
+		group.clear();
+		for (size_t j = i; j < movers.size(); j++) {
+			const Actor *actor = movers[j];
+			if (!eligible[j] || fields[j] || actor->size != size) continue;
+			if (std::abs(actor->Destination.x / 16 - goal.x) <= FLOW_GROUP_RADIUS && std::abs(actor->Destination.y / 12 - goal.y) <= FLOW_GROUP_RADIUS) {
+				group.push_back(j);
+			}
+		}
+		if (!field) {
+			if (group.size() < MIN_FLOW_MOVERS) continue;
+			field = new FlowField(this, goal, size, now, terrainGeneration);
+			flowFields.push_back(field);
+		}
+		for (size_t j : group) {
+			if (field->Reach(SearchmapPoint(movers[j]->Pos.x / 16, movers[j]->Pos.y / 12))) {
+				fields[j] = field;
+			} else {
+				// don't try it again with another field
+				eligible[j] = false;
+			}
+		}
+	}
+}
+
 void Map::DrawHighlightables() const
 {
 	// NOTE: piles are drawn in the main queue
@@ -1466,6 +1924,8 @@ void Map::AddActor(Actor* actor, bool init)
 	strnlwrcpy(actor->Area, scriptName, 8);
 	if (!HasActor(actor)) {
 		actors.push_back( actor );
+		actor->gridOrder = ++actorGridOrder;
+		AddToActorGrid(actor);
 	}
 	if (init) {
 		actor->SetMap(this);
@@ -1473,6 +1933,86 @@ void Map::AddActor(Actor* actor, bool init)
 	}
 }
 
+void Map::ResizeActorGrid()
+{
+	actorGridWidth = (Width * 16 + ACTOR_GRID_CELL - 1) / ACTOR_GRID_CELL;
+	actorGridHeight = (Height * 12 + ACTOR_GRID_CELL - 1) / ACTOR_GRID_CELL;
+	if (!actorGridWidth) actorGridWidth = 1;
+	if (!actorGridHeight) actorGridHeight = 1;
+	actorGrid.clear();
+	actorGrid.resize(actorGridWidth * actorGridHeight);
+	for (auto actor : actors) {
+		actor->gridCell = -1;
+		AddToActorGrid(actor);
+	}
+}
+
+void Map::AddToActorGrid(Actor *actor)
+{
+	unsigned int x = ActorGridIndex(actor->Pos.x, actorGridWidth);
+	unsigned int y = ActorGridIndex(actor->Pos.y, actorGridHeight);
+	actor->gridCell = (int) (y * actorGridWidth + x);
+	actorGrid[actor->gridCell].push_back(actor);
+	if (actor->size > actorGridMaxSize) {
+		actorGridMaxSize = actor->size;
+	}
+}
+
+void Map::RemoveFromActorGrid(Actor *actor)
+{
+	if (actor->gridCell < 0) {
+		return;
+	}
+	std::vector<Actor *> &cell = actorGrid[actor->gridCell];
+	for (size_t i = 0; i < cell.size(); i++) {
+		if (cell[i] == actor) {
+			cell[i] = cell.back();
+			cell.pop_back();
+			break;
+		}
+	}
+	actor->gridCell = -1;
+}
+
+void Map::UpdateActorGrid(Actor *actor)
+{
+	// not (or no longer) in our actor list
+	if (actor->gridCell < 0) {
+		return;
+	}
+	unsigned int x = ActorGridIndex(actor->Pos.x, actorGridWidth);
+	unsigned int y = ActorGridIndex(actor->Pos.y, actorGridHeight);
+	if (actor->gridCell != (int) (y * actorGridWidth + x)) {
+		RemoveFromActorGrid(actor);
+		AddToActorGrid(actor);
+	} else if (actor->size > actorGridMaxSize) {
+		actorGridMaxSize = actor->size;
+	}
+}
+
+static bool ActorListOrder(const Actor *a, const Actor *b)
+{
+	return a->gridOrder < b->gridOrder;
+}
+
+// calls visit for each actor in the buckets within the margins of p, in no
+// particular order; gridOrder tells the order of the actor list
+template <typename Visit>
+void Map::VisitActorGrid(const Point &p, long marginX, long marginY, Visit visit) const
+{
+	unsigned int x1 = ActorGridIndex(p.x - marginX, actorGridWidth);
+	unsigned int x2 = ActorGridIndex(p.x + marginX, actorGridWidth);
+	unsigned int y1 = ActorGridIndex(p.y - marginY, actorGridHeight);
+	unsigned int y2 = ActorGridIndex(p.y + marginY, actorGridHeight);
+	for (unsigned int y = y1; y <= y2; y++) {
+		for (unsigned int x = x1; x <= x2; x++) {
+			for (Actor *actor : actorGrid[y * actorGridWidth + x]) {
+				visit(actor);
+			}
+		}
+	}
+}
+
 bool Map::AnyPCSeesEnemy() const
 {
 	ieDword gametime = core->GetGame()->GameTime;
@@ -1495,6 +2035,7 @@ void Map::DeleteActor(int i)
 {
 	Actor *actor = actors[i];
 	if (actor) {
+		RemoveFromActorGrid(actor);
 		Game *game = core->GetGame();
 		//this makes sure that a PC will be demoted to NPC
 		game->LeaveParty( actor );
@@ -1602,48 +2143,63 @@ Actor* Map::GetActorByGlobalID(ieDword objectID) const
 */
 Actor* Map::GetActor(const Point &p, int flags, const Movable *checker) const
 {
-	for (auto actor : actors) {
+	// IsOver checks the ground circle, which is at least size 2
+	long reach = (std::max(actorGridMaxSize, 2) - 1) * 16;
+	// the first match in the actor list
+	Actor *first = NULL;
+	VisitActorGrid(p, reach, reach, [&](Actor *actor) {
+		if (first && first->gridOrder < actor->gridOrder)
+			return;
 		if (!actor->IsOver( p ))
-			continue;
+			return;
 		if (!actor->ValidTarget(flags, checker) ) {
-			continue;
+			return;
 		}
-		return actor;
-	}
-	return NULL;
+		first = actor;
+	});
+	return first;
 }
 
 Actor* Map::GetActorInRadius(const Point &p, int flags, unsigned int radius) const
 {
-	for (auto actor : actors) {
+	// PersonalDistance subtracts size*10
+	long reach = (long) std::min(radius, 0x10000u) + actorGridMaxSize * 10 + 1;
+	Actor *first = NULL;
+	VisitActorGrid(p, reach, reach, [&](Actor *actor) {
+		if (first && first->gridOrder < actor->gridOrder)
+			return;
 		if (PersonalDistance( p, actor ) > radius)
-			continue;
+			return;
 		if (!actor->ValidTarget(flags) ) {
-			continue;
+			return;
 		}
-		return actor;
-	}
-	return NULL;
+		first = actor;
+	});
+	return first;
 }
 
 std::vector<Actor *> Map::GetAllActorsInRadius(const Point &p, int flags, unsigned int radius, const Scriptable *see) const
 {
 	std::vector<Actor *> neighbours;
-	for (auto actor : actors) {
+	// a foot is at most 16 pixels
+	long reach = (long) std::min(radius, 0x10000u) * 16 + 1;
+	VisitActorGrid(p, reach, reach, [&](Actor *actor) {
 		if (!WithinRange(actor, p, radius)) {
-			continue;
+			return;
 		}
 		if (!actor->ValidTarget(flags, see) ) {
-			continue;
+			return;
 		}
 		if (!(flags&GA_NO_LOS)) {
 			//line of sight visibility
 			if (!IsVisibleLOS(actor->Pos, p)) {
-				continue;
+				return;
 			}
 		}
 		neighbours.emplace_back(actor);
-	}
+	});
+	// in the order of the actor list, like the callers always got them
+	std::sort(neighbours.begin(), neighbours.end(), ActorListOrder);
 	return neighbours;
 }
 
@@ -1751,6 +2307,7 @@ void Map::PurgeArea(bool items)
 		if (!actor->ValidTarget(GA_NO_DEAD|GA_NO_UNSCHEDULED|GA_NO_ALLY|GA_NO_ENEMY)) continue;
 		if (!actor->HomeLocation.isnull() && !actor->HomeLocation.isempty() && actor->Pos != actor->HomeLocation) {
 			actor->Pos = actor->HomeLocation;
+			UpdateActorGrid(actor);
 		}
 	}
 }
@@ -1871,25 +2428,29 @@ Actor *Map::GetActorByScriptName(const char *name) const
 
 int Map::GetActorInRect(Actor**& actorlist, const Region& rgn, bool onlyparty) const
 {
-	actorlist = ( Actor * * ) malloc( actors.size() * sizeof( Actor * ) );
-	int count = 0;
-	for (auto actor : actors) {
+	std::vector<Actor *> &matches = actorGridMatches;
+	matches.clear();
+	Point center(rgn.x + rgn.w / 2, rgn.y + rgn.h / 2);
+	VisitActorGrid(center, rgn.w / 2 + 1, rgn.h / 2 + 1, [&](Actor *actor) {
 //use this function only for party?
 		if (onlyparty && actor->GetStat(IE_EA)>EA_CHARMED) {
-			continue;
+			return;
 		}
 		// this is called by non-selection code..
 		if (onlyparty && !actor->ValidTarget(GA_SELECT))
-			continue;
+			return;
 		if (!actor->ValidTarget(GA_NO_DEAD|GA_NO_UNSCHEDULED))
-			continue;
+			return;
 		if ((actor->Pos.x<rgn.x) || (actor->Pos.y<rgn.y))
-			continue;
+			return;
 		if ((actor->Pos.x>rgn.x+rgn.w) || (actor->Pos.y>rgn.y+rgn.h) )
-			continue;
-		actorlist[count++] = actor;
-	}
-	actorlist = ( Actor * * ) realloc( actorlist, count * sizeof( Actor * ) );
+			return;
+		matches.push_back(actor);
+	});
+	std::sort(matches.begin(), matches.end(), ActorListOrder);
+	int count = (int) matches.size();
+	actorlist = ( Actor * * ) malloc( count * sizeof( Actor * ) );
+	std::copy(matches.begin(), matches.end(), actorlist);
 	return count;
 }
 
@@ -1946,18 +2507,18 @@ unsigned int Map::GetBlocked(unsigned int x, unsigned int y, int size) const
 
 unsigned int Map::GetBlockedNavmap(unsigned int x, unsigned int y) const
 {
-	return GetBlocked(x / 16, y / 12);
+	return searchmapView.GetBlockedNavmap(x, y);
 }
 
 // Args are in searchmap coordinates
 // The default behavior is for actors to be blocking
 // If they shouldn't be, the caller should check for PATH_MAP_PASSABLE | PATH_MAP_ACTOR
-unsigned int Map::GetBlocked(unsigned int x, unsigned int y) const
+unsigned int SearchmapView::GetBlocked(unsigned int x, unsigned int y) const
 {
-	if (y>=Height || x>=Width) {
+	if (y>=height || x>=width) {
 		return PATH_MAP_IMPASSABLE;
 	}
-	unsigned int ret = SrchMap[y*Width+x];
+	unsigned int ret = cells[y*width+x];
 	if (ret & (PATH_MAP_DOOR_IMPASSABLE|PATH_MAP_ACTOR)) {
 		ret &= ~PATH_MAP_PASSABLE;
 	}
@@ -1967,8 +2528,196 @@ unsigned int Map::GetBlocked(unsigned int x, unsigned int y) const
 	return ret;
 }
 
+unsigned int Map::GetBlocked(unsigned int x, unsigned int y) const
+{
+	return searchmapView.GetBlocked(x, y);
+}
+
+// Recomputes the clearance of every cell whose circles can reach a cell
+// in the given (searchmap) rectangle. Cells outside the map count as
+// impassable, just like in GetBlocked.
+void Map::UpdateClearance(int x1, int y1, int x2, int y2)
+{
+	const int reach = MAX_CIRCLESIZE - 2;
+	const std::vector<unsigned char> &sizeFor = CircleSizes;
+
+	x1 = std::max(x1 - reach, 0);
+	y1 = std::max(y1 - reach, 0);
+	x2 = std::min(x2 + reach, (int) Width - 1);
+	y2 = std::min(y2 + reach, (int) Height - 1);
+	if (x1 > x2 || y1 > y2) return;
+
+	// first the horizontal distance to the nearest impassable (or
+	// not plain) cell in each row, then combine the rows
+	int w = x2 - x1 + 1;
+	int rows = y2 - y1 + 1 + 2 * reach;
+	std::vector<unsigned char> impassableDist(rows * w);
+	std::vector<unsigned char> terrainDist(rows * w);
+	for (int row = 0; row < rows; row++) {
+		int y = y1 - reach + row;
+		bool rowInside = y >= 0 && y < (int) Height;
+		unsigned char *impassable = &impassableDist[row * w];
+		unsigned char *terrain = &terrainDist[row * w];
+		// left to right, then right to left
+		for (int pass = 0; pass < 2; pass++) {
+			int step = pass ? -1 : 1;
+			int end = pass ? x1 - 1 : x2 + 1;
+			int di = reach + 1;
+			int dt = reach + 1;
+			for (int x = pass ? x2 + reach : x1 - reach; x != end; x += step) {
+				unsigned short value = 0;
+				if (rowInside && x >= 0 && x < (int) Width) {
+					value = SrchMap[y * Width + x];
+				}
+				di = value == PATH_MAP_IMPASSABLE ? 0 : std::min(di + 1, reach + 1);
+				dt = (value & PATH_MAP_NOTACTOR) != PATH_MAP_PASSABLE ? 0 : std::min(dt + 1, reach + 1);
+				if (x < x1 || x > x2) continue;
+				if (pass) {
+					impassable[x - x1] = std::min<unsigned char>(impassable[x - x1], di);
+					terrain[x - x1] = std::min<unsigned char>(terrain[x - x1], dt);
+				} else {
+					impassable[x - x1] = di;
+					terrain[x - x1] = dt;
+				}
+			}
+		}
+	}
+
+	for (int y = y1; y <= y2; y++) {
+		for (int x = x1; x <= x2; x++) {
+			unsigned char ci = MAX_CIRCLESIZE + 1;
+			unsigned char ct = MAX_CIRCLESIZE + 1;
+			for (int dy = -reach; dy <= reach; dy++) {
+				int idx = (y - y1 + reach + dy) * w + x - x1;
+				int ady = std::abs(dy);
+				if (impassableDist[idx] <= reach) {
+					ci = std::min(ci, sizeFor[ady * (reach + 1) + impassableDist[idx]]);
+				}
+				if (terrainDist[idx] <= reach) {
+					ct = std::min(ct, sizeFor[ady * (reach + 1) + terrainDist[idx]]);
+				}
+			}
+			ImpassableClearance[y * Width + x] = ci;
+			TerrainClearance[y * Width + x] = ct;
+		}
+	}
+}
+
+// all searchmap changes after loading go through here, so the clearance
+// maps and the actor mark counts stay up to date
+void Map::SetSearchMapCell(unsigned int x, unsigned int y, unsigned short value)
+{
+	unsigned int pos = y * Width + x;
+	unsigned short old = SrchMap[pos];
+	if (old == value) {
+		return;
+	}
+	SrchMap[pos] = value;
+	if (!(old & PATH_MAP_ACTOR) != !(value & PATH_MAP_ACTOR)) {
+		unsigned char &marks = ActorMarks[(y / ACTOR_MARK_BLOCK) * ActorMarksWidth + x / ACTOR_MARK_BLOCK];
+		if (value & PATH_MAP_ACTOR) {
+			marks++;
+		} else {
+			marks--;
+		}
+	}
+	if ((old ^ value) & (PATH_MAP_SIDEWALL | PATH_MAP_DOOR_OPAQUE)) {
+		losMemo.clear();
+	}
+	if ((old ^ value) & (PATH_MAP_NO_SEE | PATH_MAP_SIDEWALL | PATH_MAP_DOOR_OPAQUE)) {
+		fogGeneration++;
+	}
+	if ((old & PATH_MAP_NOTACTOR) != (value & PATH_MAP_NOTACTOR) || !old != !value) {
+		UpdateClearance(x, y, x, y);
+		terrainGeneration++;
+		// eg. a door opened or closed
+		for (size_t i = 0; i < pathAbstractions.size(); i++) {
+			std::shared_ptr<PathAbstraction> &abstraction = pathAbstractions[i];
+			if (!abstraction) continue;
+			// the path batch goes on with the old graph
+			if (abstraction.use_count() > 1) {
+				abstraction = std::make_shared<PathAbstraction>(*abstraction);
+			}
+			abstraction->Invalidate(x, y, x, y);
+		}
+	}
+}
+
+// whether any searchmap cell within radius may be marked by an actor
+bool SearchmapView::ActorMarksNear(unsigned int x, unsigned int y, unsigned int radius) const
+{
+	unsigned int bx1 = (x > radius ? x - radius : 0) / ACTOR_MARK_BLOCK;
+	unsigned int by1 = (y > radius ? y - radius : 0) / ACTOR_MARK_BLOCK;
+	unsigned int bx2 = std::min(x + radius, width - 1) / ACTOR_MARK_BLOCK;
+	unsigned int by2 = std::min(y + radius, height - 1) / ACTOR_MARK_BLOCK;
+	for (unsigned int by = by1; by <= by2; by++) {
+		for (unsigned int bx = bx1; bx <= bx2; bx++) {
+			if (actorMarks[by * actorMarksWidth + bx]) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+PathAbstraction *Map::GetPathAbstraction(unsigned int size) const
+{
+	size = Clamp(size, 2u, MAX_CIRCLESIZE);
+	if (pathAbstractions.size() <= size) {
+		pathAbstractions.resize(size + 1);
+	}
+	std::shared_ptr<PathAbstraction> &abstraction = pathAbstractions[size];
+	if (!abstraction) {
+		abstraction = std::make_shared<PathAbstraction>(this, size);
+	} else if (abstraction->IsDirty() && abstraction.use_count() > 1) {
+		abstraction = std::make_shared<PathAbstraction>(*abstraction);
+	}
+	abstraction->Refresh();
+	return abstraction.get();
+}
+
+bool SearchmapView::IsPassableTerrain(unsigned int x, unsigned int y, unsigned int size) const
+{
+	if (x >= width || y >= height) {
+		return false;
+	}
+	size = Clamp(size, 2u, MAX_CIRCLESIZE);
+	unsigned int pos = y * width + x;
+	if (size >= impassableClearance[pos]) {
+		return false;
+	}
+	if (size < terrainClearance[pos]) {
+		return true;
+	}
+
+	unsigned int r = (size - 2) * (size - 2) + 1;
+	if (size == 2) r = 0;
+	unsigned int ret = 0;
+	for (unsigned int i = 0; i < size - 1; i++) {
+		for (unsigned int j = 0; j < size - 1; j++) {
+			if (i * i + j * j > r) continue;
+			// the clearance already ruled out impassable and outside cells
+			ret |= cells[(y + j) * width + x + i] | cells[(y - j) * width + x + i];
+			ret |= cells[(y + j) * width + x - i] | cells[(y - j) * width + x - i];
+		}
+	}
+	ret &= PATH_MAP_NOTACTOR;
+	if (ret & (PATH_MAP_DOOR_IMPASSABLE|PATH_MAP_SIDEWALL)) {
+		ret &= ~PATH_MAP_PASSABLE;
+	}
+	if (ret & PATH_MAP_DOOR_OPAQUE) {
+		ret = PATH_MAP_SIDEWALL;
+	}
+	return ret & (PATH_MAP_PASSABLE|PATH_MAP_TRAVEL);
+}
+
+bool Map::IsPassableTerrain(unsigned int x, unsigned int y, unsigned int size) const
+{
+	return searchmapView.IsPassableTerrain(x, y, size);
+}
+
 // Args are in navmap coordinates
-unsigned int Map::GetBlockedInRadius(unsigned int px, unsigned int py, unsigned int size, bool stopOnImpassable) const
+unsigned int SearchmapView::GetBlockedInRadius(unsigned int px, unsigned int py, unsigned int size, bool stopOnImpassable) const
 {
 	// We check a circle of radius size-2 around (px,py)
 	// Note that this does not exactly match BG2. BG2's approximations of
@@ -1978,6 +2727,20 @@ unsigned int Map::GetBlockedInRadius(unsigned int px, unsigned int py, unsigned
 	if (size < 2) size = 2;
 	unsigned int ret = 0;
 
+	// the clearance maps answer the common cases with a single lookup
+	unsigned int cx = px / 16;
+	unsigned int cy = py / 12;
+	if (impassableClearance && cx < width && cy < height) {
+		unsigned int pos = cy * width + cx;
+		if (stopOnImpassable && size >= impassableClearance[pos]) {
+			return PATH_MAP_IMPASSABLE;
+		}
+		// only plain terrain in reach, so just the actors could matter
+		if (size < terrainClearance[pos] && !ActorMarksNear(cx, cy, size - 2)) {
+			return PATH_MAP_PASSABLE;
+		}
+	}
+
 	unsigned int r = (size - 2) * (size - 2) + 1;
 	if (size == 2) r = 0;
 	for (unsigned int i = 0; i < size - 1; i++) {
@@ -2006,15 +2769,100 @@ unsigned int Map::GetBlockedInRadius(unsigned int px, unsigned int py, unsigned
 	return ret;
 }
 
-unsigned int Map::GetBlockedInLine(const Point &s, const Point &d, bool stopOnImpassable, const Actor *caller) const
+unsigned int Map::GetBlockedInRadius(unsigned int px, unsigned int py, unsigned int size, bool stopOnImpassable) const
+{
+	return searchmapView.GetBlockedInRadius(px, py, size, stopOnImpassable);
+}
+
+// floor division, so points left of or above the map land in an out of bounds cell
+static inline int SearchmapCell(int coord, int side)
+{
+	return coord >= 0 ? coord / side : (coord - side + 1) / side;
+}
+
+// ORs the status of every searchmap cell the segment touches (a supercover,
+// so both neighbours are checked when it passes exactly through a corner)
+unsigned int SearchmapView::GetBlockedInLine(const Point &s, const Point &d, bool stopOnImpassable, double stepFactor) const
+{
+	if (sampledLines) {
+		return GetBlockedInSampledLine(s, d, stopOnImpassable, stepFactor);
+	}
+	if (s == d) {
+		return 0;
+	}
+
+	int cx = SearchmapCell(s.x, 16);
+	int cy = SearchmapCell(s.y, 12);
+	int ex = SearchmapCell(d.x, 16);
+	int ey = SearchmapCell(d.y, 12);
+	int stepX = d.x > s.x ? 1 : -1;
+	int stepY = d.y > s.y ? 1 : -1;
+	long dx = std::abs(d.x - s.x);
+	long dy = std::abs(d.y - s.y);
+	// distance in pixels to the next cell border along each axis; the line
+	// reaches the x border first if nextX / dx < nextY / dy
+	long nextX = stepX > 0 ? (cx + 1) * 16 - s.x : s.x - cx * 16;
+	long nextY = stepY > 0 ? (cy + 1) * 12 - s.y : s.y - cy * 12;
+	int moves = std::abs(ex - cx) + std::abs(ey - cy);
+
+	unsigned int ret = GetBlocked(cx, cy);
+	if (stopOnImpassable && ret == PATH_MAP_IMPASSABLE) {
+		return PATH_MAP_IMPASSABLE;
+	}
+	while (moves > 0) {
+		long crossX = dx ? nextX * dy : 1;
+		long crossY = dy ? nextY * dx : 1;
+		if (!dy || (dx && crossX < crossY)) {
+			cx += stepX;
+			nextX += 16;
+			moves--;
+		} else if (!dx || crossX > crossY || (moves < 2 && cx == ex)) {
+			cy += stepY;
+			nextY += 12;
+			moves--;
+		} else if (moves < 2) {
+			// both borders lie on the end point, only one of them leads there
+			cx += stepX;
+			nextX += 16;
+			moves--;
+		} else {
+			unsigned int sideX = GetBlocked(cx + stepX, cy);
+			unsigned int sideY = GetBlocked(cx, cy + stepY);
+			if (stopOnImpassable && (sideX == PATH_MAP_IMPASSABLE || sideY == PATH_MAP_IMPASSABLE)) {
+				return PATH_MAP_IMPASSABLE;
+			}
+			ret |= sideX | sideY;
+			cx += stepX;
+			cy += stepY;
+			nextX += 16;
+			nextY += 12;
+			moves -= 2;
+		}
+		unsigned int blockStatus = GetBlocked(cx, cy);
+		if (stopOnImpassable && blockStatus == PATH_MAP_IMPASSABLE) {
+			return PATH_MAP_IMPASSABLE;
+		}
+		ret |= blockStatus;
+	}
+	if (ret & (PATH_MAP_DOOR_IMPASSABLE|PATH_MAP_ACTOR|PATH_MAP_SIDEWALL)) {
+		ret &= ~PATH_MAP_PASSABLE;
+	}
+	if (ret & PATH_MAP_DOOR_OPAQUE) {
+		ret = PATH_MAP_SIDEWALL;
+	}
+
+	return ret;
+}
+
+// the older walker, sampling the line every few navmap pixels
+unsigned int SearchmapView::GetBlockedInSampledLine(const Point &s, const Point &d, bool stopOnImpassable, double stepFactor) const
 {
 	unsigned int ret = 0;
 	Point p = s;
 	while (p != d) {
 		double dx = d.x - p.x;
 		double dy = d.y - p.y;
-		double factor = caller && caller->GetSpeed() ? double(gamedata->GetStepTime()) / double(caller->GetSpeed()) : 1;
-		NormalizeDeltas(dx, dy, factor);
+		Map::NormalizeDeltas(dx, dy, stepFactor);
 		p.x += dx;
 		p.y += dy;
 		int blockStatus = GetBlockedNavmap(p.x, p.y);
@@ -2033,20 +2881,55 @@ unsigned int Map::GetBlockedInLine(const Point &s, const Point &d, bool stopOnIm
 	return ret;
 }
 
+unsigned int Map::GetBlockedInLine(const Point &s, const Point &d, bool stopOnImpassable, const Actor *caller) const
+{
+	return searchmapView.GetBlockedInLine(s, d, stopOnImpassable, StepFactor(caller));
+}
+
+// the walking step of the caller, for the sampled lines
+double Map::StepFactor(const Actor *caller)
+{
+	return caller && caller->GetSpeed() ? double(gamedata->GetStepTime()) / double(caller->GetSpeed()) : 1;
+}
+
 // PATH_MAP_SIDEWALL obstructs LOS, while PATH_MAP_IMPASSABLE doesn't
+// scripts and targeting keep asking about the same pairs within a tick, so
+// the rays are memoized (main thread only)
 bool Map::IsVisibleLOS(const Point &s, const Point &d, const Actor *caller) const
 {
+	// the sampled lines step by the caller's speed, so the endpoints don't decide the answer
+	if (searchmapView.sampledLines) {
+		losRays++;
+		return !(GetBlockedInLine(s, d, false, caller) & PATH_MAP_SIDEWALL);
+	}
+
+	unsigned long long key = ((unsigned long long) (ieWord) s.x << 48) | ((unsigned long long) (ieWord) s.y << 32) |
+		((ieDword) (ieWord) d.x << 16) | (ieWord) d.y;
+	auto memo = losMemo.find(key);
+	if (memo != losMemo.end()) {
+		losMemoHits++;
+		return memo->second;
+	}
+
+	losRays++;
 	unsigned ret = GetBlockedInLine(s, d, false, caller);
-	return !(ret & PATH_MAP_SIDEWALL);
+	bool visible = !(ret & PATH_MAP_SIDEWALL);
+	losMemo[key] = visible;
+	return visible;
 }
 
 // Used by the pathfinder, so PATH_MAP_IMPASSABLE obstructs walkability
-bool Map::IsWalkableTo(const Point &s, const Point &d, bool actorsAreBlocking, const Actor *caller) const
+bool SearchmapView::IsWalkableTo(const Point &s, const Point &d, bool actorsAreBlocking, double stepFactor) const
 {
-	unsigned ret = GetBlockedInLine(s, d, true, caller);
+	unsigned ret = GetBlockedInLine(s, d, true, stepFactor);
 	return ret & (PATH_MAP_PASSABLE | PATH_MAP_TRAVEL | (actorsAreBlocking ? 0 : PATH_MAP_ACTOR));
 }
 
+bool Map::IsWalkableTo(const Point &s, const Point &d, bool actorsAreBlocking, const Actor *caller) const
+{
+	return searchmapView.IsWalkableTo(s, d, actorsAreBlocking, StepFactor(caller));
+}
+
 //flags:0 - never dither (full cover)
 //	1 - dither if polygon wants it
 //	2 - always dither
@@ -2062,20 +2945,38 @@ SpriteCover* Map::BuildSpriteCover(int x, int y, int xpos, int ypos,
 	sc->Width = width;
 	sc->Height = height;
 
+	CoverKey key = { x, y, xpos, ypos, width, height, flags, areaanim };
+	auto cached = coverCache.find(key);
+	if (cached != coverCache.end()) {
+		coverCacheHits++;
+		sc->flags = flags;
+		sc->spans = cached->second;
+		return sc;
+	}
+
 	Video* video = core->GetVideoDriver();
 	video->InitSpriteCover(sc, flags);
 
+	// the world area of the cover, a pixel wider all around, as the
+	// polygons cover their right edge
+	Region area(x - xpos - 1, y - ypos - 1, width + 2, height + 2);
 	unsigned int wpcount = GetWallCount();
 	for (unsigned int i = 0; i < wpcount; ++i)
 	{
 		Wall_Polygon* wp = GetWallGroup(i);
 		if (!wp) continue;
+		if (!wp->BBox.IntersectsRegion(area)) continue;
 		if (!wp->PointCovered(x, y)) continue;
 		if (areaanim && !(wp->GetPolygonFlag() & WF_COVERANIMS)) continue;
 
 		video->AddPolygonToSpriteCover(sc, wp);
 	}
 
+	coversBuilt++;
+	if (coverCache.size() >= MAX_COVER_CACHE) {
+		coverCache.clear();
+	}
+	coverCache[key] = sc->spans;
 	return sc;
 }
 
@@ -2096,6 +2997,7 @@ void Map::ActivateWallgroups(unsigned int baseindex, unsigned int count, int flg
 		wp->SetPolygonFlag(value);
 	}
 	//all actors will have to generate a new spritecover
+	coverCache.clear();
 	for (auto actor : actors) {
 		actor->SetSpriteCover(NULL);
 	}
@@ -2333,6 +3235,7 @@ void Map::RemoveActor(Actor* actor)
 			//path is invalid outside this area, but actions may be valid
 			actor->ClearPath(true);
 			ClearSearchMapFor(actor);
+			RemoveFromActorGrid(actor);
 			actor->SetMap(NULL);
 			CopyResRef(actor->Area, "");
 			actors.erase( actors.begin()+i );
@@ -2381,6 +3284,8 @@ void Map::dump(bool show_actors) const
 	buffer.appendFormatted( "Weather: %s\n", YESNO(AreaType & AT_WEATHER ) );
 	buffer.appendFormatted( "Area Type: %d\n", AreaType & (AT_CITY|AT_FOREST|AT_DUNGEON) );
 	buffer.appendFormatted("Can rest: %s\n", YESNO(!core->GetGame()->CanPartyRest(REST_AREA)));
+	buffer.appendFormatted("Line of sight: %lu rays traced, %lu answered from the memo\n", losRays, losMemoHits);
+	buffer.appendFormatted("Sprite covers: %lu built, %lu shared from the cache\n", coversBuilt, coverCacheHits);
 
 	if (show_actors) {
 		buffer.append("\n");
@@ -2817,9 +3722,70 @@ void Map::ExploreTile(const Point &pos)
 	VisibleBitmap[by] |= bi;
 }
 
+// Packs fog tile indices into a slice of the fog bitmap layout, starting at
+// byte first. Repeated tiles just set their bit again.
+static void PackFogTiles(const std::vector<unsigned int> &tiles, unsigned int &first, std::vector<ieByte> &bits)
+{
+	bits.clear();
+	first = 0;
+	if (tiles.empty()) {
+		return;
+	}
+	unsigned int last = tiles[0] / 8;
+	first = last;
+	for (unsigned int b0 : tiles) {
+		first = std::min(first, b0 / 8);
+		last = std::max(last, b0 / 8);
+	}
+	bits.assign(last - first + 1, 0);
+	for (unsigned int b0 : tiles) {
+		bits[b0 / 8 - first] |= 1 << (b0 % 8);
+	}
+}
+
+// ORing bytes packed into a word gives the same bytes on any endianness,
+// so the slice is applied a word at a time, skipping the empty words
+// (most of each row the sight doesn't reach)
+void Map::RevealFogBits(unsigned int first, const std::vector<ieByte> &bits)
+{
+	const ieByte *src = bits.data();
+	ieByte *explored = ExploredBitmap + first;
+	ieByte *visible = VisibleBitmap + first;
+	size_t count = bits.size();
+	size_t i = 0;
+	for (; i + sizeof(ieDword) <= count; i += sizeof(ieDword)) {
+		ieDword word;
+		memcpy(&word, src + i, sizeof(word));
+		if (!word) continue;
+		ieDword dst;
+		memcpy(&dst, explored + i, sizeof(dst));
+		dst |= word;
+		memcpy(explored + i, &dst, sizeof(dst));
+		memcpy(&dst, visible + i, sizeof(dst));
+		dst |= word;
+		memcpy(visible + i, &dst, sizeof(dst));
+	}
+	for (; i < count; i++) {
+		explored[i] |= src[i];
+		visible[i] |= src[i];
+	}
+}
+
 void Map::ExploreMapChunk(const Point &Pos, int range, int los)
+{
+	std::vector<unsigned int> tiles;
+	CollectMapChunk(Pos, range, los, tiles);
+	unsigned int first;
+	std::vector<ieByte> bits;
+	PackFogTiles(tiles, first, bits);
+	RevealFogBits(first, bits);
+}
+
+void Map::CollectMapChunk(const Point &Pos, int range, int los, std::vector<unsigned int> &tiles) const
 {
 	Point Tile;
+	int w = TMap->XCellCount * 2 + LargeFog;
+	int h = TMap->YCellCount * 2 + LargeFog;
 
 	if (range>MaxVisibility) {
 		range=MaxVisibility;
@@ -2850,35 +3816,67 @@ void Map::ExploreMapChunk(const Point &Pos, int range, int los)
 					if (!Pass) break;
 				}
 			}
-			ExploreTile(Tile);
+			// same bounds as ExploreTile
+			int x = Tile.x / 32;
+			int y = Tile.y / 32;
+			if (x >= 0 && x < w && y >= 0 && y < h) {
+				tiles.push_back(y * w + x);
+			}
 		}
 	}
 }
 
 void Map::UpdateFog()
 {
-	if (!(core->FogOfWar&FOG_DRAWFOG) ) {
+	bool drawFog = core->FogOfWar & FOG_DRAWFOG;
+	if (!drawFog) {
 		SetMapVisibility( -1 );
 		Explore(-1);
+		fogContributions.clear();
 	} else {
 		SetMapVisibility( 0 );
 	}
 
+	// each actor's sight is only traced again when something it depends on
+	// changed, otherwise the tiles from the last time are reapplied
+	fogStamp++;
+	std::vector<unsigned int> tiles;
 	for (size_t i = 0; i < actors.size(); i++) {
 		const Actor *actor = actors[i];
 		if (!actor->Modified[ IE_EXPLORE ] ) continue;
-		if (core->FogOfWar&FOG_DRAWFOG) {
+		if (drawFog) {
 			int state = actor->Modified[IE_STATE_ID];
 			if (state & STATE_CANTSEE) continue;
 			int vis2 = actor->Modified[IE_VISUALRANGE];
 			if ((state&STATE_BLIND) || (vis2<2)) vis2=2; //can see only themselves
-			ExploreMapChunk (actor->Pos, vis2+actor->GetAnims()->GetCircleSize(), 1);
+			int range = vis2 + actor->GetAnims()->GetCircleSize();
+
+			FogContribution &fog = fogContributions[actor->GetGlobalID()];
+			if (fog.Generation != fogGeneration || fog.Pos != actor->Pos || fog.Range != range) {
+				fog.Generation = fogGeneration;
+				fog.Pos = actor->Pos;
+				fog.Range = range;
+				tiles.clear();
+				CollectMapChunk(actor->Pos, range, 1, tiles);
+				PackFogTiles(tiles, fog.First, fog.Bits);
+			}
+			fog.Stamp = fogStamp;
+			RevealFogBits(fog.First, fog.Bits);
 		}
 		Spawn *sp = GetSpawnRadius(actor->Pos, SPAWN_RANGE); //30 * 12
 		if (sp) {
 			TriggerSpawn(sp);
 		}
 	}
+
+	// forget the actors that left, died or stopped exploring
+	for (auto fog = fogContributions.begin(); fog != fogContributions.end();) {
+		if (fog->second.Stamp != fogStamp) {
+			fog = fogContributions.erase(fog);
+		} else {
+			++fog;
+		}
+	}
 }
 
 // Valid values are - PATH_MAP_UNMARKED, PATH_MAP_PC, PATH_MAP_NPC
@@ -2904,21 +3902,17 @@ void Map::BlockSearchMap(const Point &Pos, unsigned int size, unsigned int value
 				unsigned int ppypj = ppy+j;
 				unsigned int ppxmi = ppx-i;
 				unsigned int ppymj = ppy-j;
-				unsigned int pos = ppypj * Width + ppxpi;
-				if (ppxpi < Width && ppypj < Height && SrchMap[pos] != PATH_MAP_IMPASSABLE) {
-					SrchMap[pos] = (SrchMap[pos] & PATH_MAP_NOTACTOR) | value;
+				if (ppxpi < Width && ppypj < Height && SrchMap[ppypj * Width + ppxpi] != PATH_MAP_IMPASSABLE) {
+					SetSearchMapCell(ppxpi, ppypj, (SrchMap[ppypj * Width + ppxpi] & PATH_MAP_NOTACTOR) | value);
 				}
-				pos = ppymj * Width + ppxpi;
-				if (ppxpi < Width && ppymj < Height && SrchMap[pos] != PATH_MAP_IMPASSABLE) {
-					SrchMap[pos] = (SrchMap[pos] & PATH_MAP_NOTACTOR) | value;
+				if (ppxpi < Width && ppymj < Height && SrchMap[ppymj * Width + ppxpi] != PATH_MAP_IMPASSABLE) {
+					SetSearchMapCell(ppxpi, ppymj, (SrchMap[ppymj * Width + ppxpi] & PATH_MAP_NOTACTOR) | value);
 				}
-				pos = ppypj * Width + ppxmi;
-				if (ppxmi < Width && ppypj < Height && SrchMap[pos] != PATH_MAP_IMPASSABLE) {
-					SrchMap[pos] = (SrchMap[pos] & PATH_MAP_NOTACTOR) | value;
+				if (ppxmi < Width && ppypj < Height && SrchMap[ppypj * Width + ppxmi] != PATH_MAP_IMPASSABLE) {
+					SetSearchMapCell(ppxmi, ppypj, (SrchMap[ppypj * Width + ppxmi] & PATH_MAP_NOTACTOR) | value);
 				}
-				pos = ppymj * Width + ppxmi;
-				if (ppxmi < Width && ppymj < Height && SrchMap[pos] != PATH_MAP_IMPASSABLE) {
-					SrchMap[pos] = (SrchMap[pos] & PATH_MAP_NOTACTOR) | value;
+				if (ppxmi < Width && ppymj < Height && SrchMap[ppymj * Width + ppxmi] != PATH_MAP_IMPASSABLE) {
+					SetSearchMapCell(ppxmi, ppymj, (SrchMap[ppymj * Width + ppxmi] & PATH_MAP_NOTACTOR) | value);
 				}
 			}
 		}
@@ -3563,7 +4557,7 @@ void Map::SetInternalSearchMap(int x, int y, int value)
 	if ((unsigned)x >= Width || (unsigned)y >= Height) {
 		return;
 	}
-	SrchMap[x+y*Width] = value;
+	SetSearchMapCell(x, y, value);
 }
 
 void Map::SetBackground(const ieResRef &bgResRef, ieDword duration)
@@ -29,7 +29,9 @@
 #include "PathFinder.h"
 
 #include <algorithm>
+#include <memory>
 #include <queue>
+#include <unordered_map>
 
 template <class V> class FibonacciHeap;
 
@@ -47,10 +49,12 @@ class IniSpawn;
 class MapReverb;
 class Palette;
 class Particles;
+class Path;
 struct PathNode;
 class Projectile;
 class ScriptedAnimation;
 class SpriteCover;
+struct CoverSpans;
 class TileMap;
 class VEFObject;
 class Wall_Polygon;
@@ -268,6 +272,51 @@ public:
 	}
 };
 
+// the fog tiles one exploring actor revealed, reused by UpdateFog until
+// the actor moves, its visual range changes or a sight blocker changes
+class FogContribution {
+public:
+	Point Pos;
+	int Range;
+	ieDword Generation;
+	ieDword Stamp;
+	// the revealed tiles as a slice of the fog bitmap, starting at byte First
+	unsigned int First;
+	std::vector<ieByte> Bits;
+
+	FogContribution() {
+		Range = 0;
+		Generation = 0;
+		Stamp = 0;
+		First = 0;
+	}
+};
+
+// what a sprite cover was built for, see Map::BuildSpriteCover
+struct CoverKey {
+	int x, y, xpos, ypos;
+	unsigned int width, height;
+	int flags;
+	bool areaanim;
+
+	bool operator==(const CoverKey& other) const {
+		return x == other.x && y == other.y && xpos == other.xpos && ypos == other.ypos &&
+			width == other.width && height == other.height &&
+			flags == other.flags && areaanim == other.areaanim;
+	}
+};
+
+struct CoverKeyHash {
+	size_t operator()(const CoverKey& key) const {
+		size_t hash = (size_t) key.x * 31 + key.y;
+		hash = hash * 31 + key.xpos;
+		hash = hash * 31 + key.ypos;
+		hash = hash * 31 + key.width;
+		hash = hash * 31 + key.height;
+		return hash * 31 + key.flags * 2 + key.areaanim;
+	}
+};
+
 class GEM_EXPORT AreaAnimation {
 public:
 	Animation **animation;
@@ -355,9 +404,57 @@ private:
 	ieWord trackDiff;
 	unsigned short* SrchMap; //internal searchmap
 	unsigned short* MaterialMap;
+	// smallest GetBlockedInRadius circle size that reaches an impassable cell
+	// (or one with anything but plain passable terrain), MAX_CIRCLESIZE+1 if none
+	unsigned char* ImpassableClearance;
+	unsigned char* TerrainClearance;
+	// number of actor marked searchmap cells in each ACTOR_MARK_BLOCK square
+	unsigned char* ActorMarks;
+	unsigned int ActorMarksWidth;
+	// over the arrays above, what the live searches read
+	SearchmapView searchmapView;
 	unsigned int Width, Height;
 	std::list< AreaAnimation*> animations;
 	std::vector< Actor*> actors;
+	// actors bucketed by position, so the point, radius and rect queries
+	// only need to look at the nearby ones
+	std::vector< std::vector< Actor*> > actorGrid;
+	unsigned int actorGridWidth, actorGridHeight;
+	int actorGridMaxSize;
+	ieDword actorGridOrder;
+	// reused by GetActorInRect
+	mutable std::vector<Actor *> actorGridMatches;
+	// reused by every FindPath call of the main thread
+	mutable PathWorkspace pathWorkspace;
+	// cluster graphs for the long searches, built on demand for each size;
+	// shared with the path batch, which keeps reading the old graph when the
+	// terrain changes meanwhile
+	mutable std::vector<std::shared_ptr<PathAbstraction> > pathAbstractions;
+	// global IDs of the actors waiting for a new path, in request order
+	std::vector<ieDword> pathRequests;
+	// the requests being searched off the update, and the threads doing it
+	PathBatch pathBatch;
+	PathWorkers *pathWorkers;
+	// flow fields of the recent group moves, oldest first
+	std::vector<FlowField *> flowFields;
+	// bumped whenever the terrain of the searchmap changes
+	ieDword terrainGeneration;
+	// IsVisibleLOS results by exact endpoint pair, dropped every tick and
+	// whenever an opaque searchmap bit changes
+	mutable std::unordered_map<unsigned long long, bool> losMemo;
+	mutable unsigned long losRays;
+	mutable unsigned long losMemoHits;
+	// cached fog of war sight of each exploring actor, by global ID
+	std::unordered_map<ieDword, FogContribution> fogContributions;
+	// bumped whenever a searchmap bit that blocks sight changes
+	ieDword fogGeneration;
+	ieDword fogStamp;
+	// spans of the recently built sprite covers, so a cover rebuilt for the
+	// same place and box (reselected actor, vvc phase) shares them; dropped
+	// whenever the wall groups change
+	mutable std::unordered_map<CoverKey, std::shared_ptr<CoverSpans>, CoverKeyHash> coverCache;
+	unsigned long coversBuilt;
+	unsigned long coverCacheHits;
 	Wall_Polygon **Walls;
 	unsigned int WallCount;
 	std::list< VEFObject*> vvcCells;
@@ -430,11 +527,15 @@ public:
 	void InitActors();
 	void InitActor(Actor *actor);
 	void AddActor(Actor* actor, bool init);
+	/* moves the actor to the right grid bucket, call it when its position changes */
+	void UpdateActorGrid(Actor *actor);
 	//counts the summons already in the area
 	int CountSummons(ieDword flag, ieDword sex) const;
 	//returns true if an enemy is near P (used in resting/saving)
 	bool AnyEnemyNearPoint(const Point &p) const;
 	unsigned int GetBlockedInRadius(unsigned int px, unsigned int py, unsigned int size, bool stopOnImpassable = true) const;
+	/* like GetBlockedInRadius, but for a searchmap cell and ignoring the actors */
+	bool IsPassableTerrain(unsigned int x, unsigned int y, unsigned int size) const;
 	unsigned int GetBlocked(unsigned int x, unsigned int y) const;
 	unsigned int GetBlocked(unsigned int x, unsigned int y, int size) const;
 	unsigned int GetBlockedNavmap(unsigned int x, unsigned int y) const;
@@ -520,7 +621,38 @@ public:
 	void ExploreMapChunk(const Point &Pos, int range, int los);
 	/* block or unblock searchmap with value */
 	void BlockSearchMap(const Point &Pos, unsigned int size, unsigned int value);
+private:
+	/* fog tile indices ExploreMapChunk would explore, possibly repeated */
+	void CollectMapChunk(const Point &Pos, int range, int los, std::vector<unsigned int> &tiles) const;
+	/* ORs a slice of fog bits, starting at byte first, into the explored and visible bitmaps */
+	void RevealFogBits(unsigned int first, const std::vector<ieByte> &bits);
+	void SetSearchMapCell(unsigned int x, unsigned int y, unsigned short value);
+	void UpdateClearance(int x1, int y1, int x2, int y2);
+	class LivePathContext;
+	class SnapshotPathContext;
+	const SearchmapView &GetSearchmapView() const { return searchmapView; }
+	static double StepFactor(const Actor *caller);
+	PathAbstraction *GetPathAbstraction(unsigned int size) const;
+	NavmapPoint GetPathDestination(const Point &d, unsigned int size) const;
+	Path *FindPath(const Point &s, const Point &d, const NavmapPoint &nmptDest, unsigned int size, unsigned int minDistance, int flags, const PathContext &ctx, PathWorkspace &ws) const;
+	bool SearchPath(const NavmapPoint &s, NavmapPoint d, const Point &sightTarget, unsigned int size, unsigned int minDistance, int flags, const PathContext &ctx, PathWorkspace &ws) const;
+	bool FindHierarchicalPath(const NavmapPoint &s, const NavmapPoint &d, const Point &sightTarget, unsigned int size, unsigned int minDistance, int flags, const PathContext &ctx, PathWorkspace &ws) const;
+	Path *BuildPath(const std::vector<NavmapPoint> &route, int flags) const;
+	Path *FindFlowPath(const Point &s, const Point &d, const FlowField &field, int flags, const PathContext &ctx, PathWorkspace &ws) const;
+	void ResolvePathRequests();
+	void StartPathBatch(const std::vector<Actor *> &movers);
+	void FinishPathBatch();
+	void DropPathBatch();
+	void SnapshotSearchmap();
+	void AssignFlowFields(const std::vector<Actor *> &movers, std::vector<FlowField *> &fields);
+	void ResizeActorGrid();
+	void AddToActorGrid(Actor *actor);
+	void RemoveFromActorGrid(Actor *actor);
+	template <typename Visit>
+	void VisitActorGrid(const Point &p, long marginX, long marginY, Visit visit) const;
+public:
 	void ClearSearchMapFor(const Movable *actor);
+	void ClearSearchMapFor(const std::vector<Actor *> &movers);
 	/* update VisibleBitmap by resolving vision of all explore actors */
 	void UpdateFog();
 	//PathFinder
@@ -528,19 +660,21 @@ public:
 	void AdjustPosition(Point &goal, unsigned int radiusx = 0, unsigned int radiusy = 0, int size = -1) const;
 	void AdjustPositionNavmap(Point &goal, unsigned int radiusx = 0, unsigned int radiusy = 0) const;
 	/* Finds the path which leads the farthest from d */
-	PathNode* RunAway(const Point &s, const Point &d, unsigned int size, int maxPathLength, bool backAway, const Actor *caller) const;
-	PathNode* RandomWalk(const Point &s, int size, int radius, const Actor *caller) const;
+	Path *RunAway(const Point &s, const Point &d, unsigned int size, int maxPathLength, bool backAway, const Actor *caller) const;
+	Path *RandomWalk(const Point &s, int size, int radius, const Actor *caller) const;
 	/* Returns true if there is no path to d */
 	bool TargetUnreachable(const Point &s, const Point &d, unsigned int size, bool actorsAreBlocking = false) const;
 	/* returns true if there is enemy visible */
 	bool AnyPCSeesEnemy() const;
 	/* Finds straight path from s, length l and orientation o, f=1 passes wall, f=2 rebounds from wall*/
 	PathNode* GetLine(const Point &start, const Point &dest, int flags) const;
-	PathNode* GetLine(const Point &start, int steps, unsigned int orient) const;
+	Path *GetLine(const Point &start, int steps, unsigned int orient) const;
 	PathNode* GetLine(const Point &start, int Steps, int Orientation, int flags) const;
 	PathNode* GetLine(const Point &start, const Point &dest, int speed, int Orientation, int flags) const;
 	/* Finds the path which leads to near d */
-	PathNode* FindPath(const Point &s, const Point &d, unsigned int size, unsigned int minDistance = 0, int flags = PF_SIGHT, const Actor *caller = NULL) const;
+	Path *FindPath(const Point &s, const Point &d, unsigned int size, unsigned int minDistance = 0, int flags = PF_SIGHT, const Actor *caller = NULL) const;
+	/* queues a new path to the actor's destination, searched off the update */
+	void RequestPath(const Actor *actor);
 
 	/* returns false if point isn't visible on visibility/explored map */
 	bool IsVisible(const Point &s, int explored) const;
@@ -34,12 +34,12 @@
 // Moving to each node in the path thus becomes an automatic regulation problem
 // which is solved with a P regulator, see Scriptable.cpp
 
-#include "FibonacciHeap.h"
 #include "GameData.h"
 #include "Map.h"
 #include "PathFinder.h"
 #include "RNG.h"
 #include "Scriptable/Actor.h"
+#include "System/StringBuffer.h"
 
 #include <array>
 #include <cmath>
@@ -50,6 +50,14 @@ namespace GemRB {
 constexpr size_t DEGREES_OF_FREEDOM = 4;
 constexpr size_t RAND_DEGREES_OF_FREEDOM = 16;
 constexpr unsigned int SEARCHMAP_SQUARE_DIAGONAL = 20; // sqrt(16 * 16 + 12 * 12)
+// side of the path abstraction clusters in searchmap cells
+constexpr unsigned int HPA_CLUSTER_SIZE = 16;
+// searches at least this long (in searchmap cells) go over the clusters
+constexpr unsigned int HPA_MIN_DISTANCE = 2 * HPA_CLUSTER_SIZE;
+// border runs at least this long get an entrance at both ends
+constexpr unsigned int HPA_ENTRANCE_SPLIT = 6;
+constexpr unsigned int HPA_STRAIGHT_COST = 10;
+constexpr unsigned int HPA_DIAGONAL_COST = 14;
 constexpr std::array<char, DEGREES_OF_FREEDOM> dxAdjacent{{1, 0, -1, 0}};
 constexpr std::array<char, DEGREES_OF_FREEDOM> dyAdjacent{{0, 1, 0, -1}};
 
@@ -58,8 +66,36 @@ constexpr std::array<double, RAND_DEGREES_OF_FREEDOM> dxRand{{0.000, -0.383, -0.
 // Sines
 constexpr std::array<double, RAND_DEGREES_OF_FREEDOM> dyRand{{1.000, 0.924, 0.707, 0.383, 0.000, -0.383, -0.707, -0.924, -1.000, -0.924, -0.707, -0.383, 0.000, 0.383, 0.707, 0.924}};
 
+// the searches of the main thread, on the live map
+class Map::LivePathContext : public PathContext {
+public:
+	LivePathContext(const Map *map, const Actor *caller)
+	: map(map), caller(caller), searchmap(map->GetSearchmapView())
+	{
+	}
+
+	const SearchmapView &GetSearchmap() const override { return searchmap; }
+	bool IsActorInTheWay(const Point &p, bool actorsAreBlocking) const override
+	{
+		// most of the map has no actor around, so no need to look for one
+		unsigned int reach = (std::max(map->actorGridMaxSize, 2) - 1) * 16 / 12 + 1;
+		if (p.x < 0 || p.y < 0 || !searchmap.ActorMarksNear(p.x / 16, p.y / 12, reach)) return false;
+		const Actor *actor = map->GetActor(p, GA_NO_DEAD|GA_NO_UNSCHEDULED);
+		return actor && actor != caller && (actorsAreBlocking || !actor->ValidTarget(GA_ONLY_BUMPABLE));
+	}
+	const PathAbstraction *GetPathAbstraction(unsigned int size) const override { return map->GetPathAbstraction(size); }
+	double GetStepFactor() const override { return StepFactor(caller); }
+	const char *GetCallerName() const override { return caller ? caller->GetName(0) : "nullptr"; }
+	void LogDebug(const char *owner, const StringBuffer &message) const override { Log(DEBUG, owner, message); }
+
+private:
+	const Map *map;
+	const Actor *caller;
+	SearchmapView searchmap;
+};
+
 // Find the best path of limited length that brings us the farthest from d
-PathNode *Map::RunAway(const Point &s, const Point &d, unsigned int size, int maxPathLength, bool backAway, const Actor *caller) const
+Path *Map::RunAway(const Point &s, const Point &d, unsigned int size, int maxPathLength, bool backAway, const Actor *caller) const
 {
 	if (!caller || !caller->GetSpeed()) return nullptr;
 	Point p = s;
@@ -86,7 +122,7 @@ PathNode *Map::RunAway(const Point &s, const Point &d, unsigned int size, int ma
 	return FindPath(s, p, size, size, flags, caller);
 }
 
-PathNode *Map::RandomWalk(const Point &s, int size, int radius, const Actor *caller) const
+Path *Map::RandomWalk(const Point &s, int size, int radius, const Actor *caller) const
 {
 	if (!caller || !caller->GetSpeed()) return nullptr;
 	NavmapPoint p = s;
@@ -119,31 +155,23 @@ PathNode *Map::RandomWalk(const Point &s, int size, int radius, const Actor *cal
 		p.x -= dx;
 		p.y -= dy;
 	}
-	PathNode *step = new PathNode;
+	Path *path = new Path(1);
+	PathNode *step = path->Front();
 	step->x = p.x;
 	step->y = p.y;
 	step->x = Clamp(step->x, 1u, (Width - 1) * 16);
 	step->y = Clamp(step->y, 1u, (Height - 1) * 12);
-	step->Parent = nullptr;
-	step->Next = nullptr;
 	step->orient = GetOrient(p, s);
-	return step;
+	return path;
 }
 
 bool Map::TargetUnreachable(const Point &s, const Point &d, unsigned int size, bool actorsAreBlocking) const
 {
 	int flags = PF_SIGHT;
 	if (actorsAreBlocking) flags |= PF_ACTORS_ARE_BLOCKING;
-	PathNode *path = FindPath(s, d, size, 0, flags);
+	Path *path = FindPath(s, d, size, 0, flags);
 	bool targetUnreachable = path == nullptr;
-	if (!targetUnreachable) {
-		PathNode *thisNode = path;
-		while (thisNode) {
-			PathNode *nextNode = thisNode->Next;
-			delete(thisNode);
-			thisNode = nextNode;
-		}
-	}
+	delete path;
 	return targetUnreachable;
 }
 
@@ -237,26 +265,30 @@ PathNode *Map::GetLine(const Point &start, const Point &dest, int Speed, int Ori
 	return Return;
 }
 
-PathNode *Map::GetLine(const Point &p, int steps, unsigned int orient) const
+Path *Map::GetLine(const Point &p, int steps, unsigned int orient) const
 {
-	PathNode *step = new PathNode;
+	Path *path = new Path(1);
+	PathNode *step = path->Front();
 	step->x = p.x + steps * SEARCHMAP_SQUARE_DIAGONAL * dxRand[orient];
 	step->y = p.y + steps * SEARCHMAP_SQUARE_DIAGONAL * dyRand[orient];
 	step->x = Clamp(step->x, 1u, (Width - 1) * 16);
 	step->y = Clamp(step->y, 1u, (Height - 1) * 12);
 	step->orient = GetOrient(Point(step->x, step->y), p);
-	step->Next = nullptr;
-	step->Parent = nullptr;
-	return step;
+	return path;
 }
 
 // Find a path from start to goal, ending at the specified distance from the
 // target (the goal must be in sight of the end, if PF_SIGHT is specified)
-PathNode *Map::FindPath(const Point &s, const Point &d, unsigned int size, unsigned int minDistance, int flags, const Actor *caller) const
+Path *Map::FindPath(const Point &s, const Point &d, unsigned int size, unsigned int minDistance, int flags, const Actor *caller) const
+{
+	LivePathContext ctx(this, caller);
+	return FindPath(s, d, GetPathDestination(d, size), size, minDistance, flags, ctx, pathWorkspace);
+}
+
+// where a search for d has to lead, on the live map
+NavmapPoint Map::GetPathDestination(const Point &d, unsigned int size) const
 {
-	Log(DEBUG, "FindPath", "s = (%d, %d), d = (%d, %d), caller = %s, dist = %d, size = %d", s.x, s.y, d.x, d.y, caller ? caller->GetName(0) : "nullptr", minDistance, size);
 	NavmapPoint nmptDest = d;
-	NavmapPoint nmptSource = s;
 	if (!(GetBlockedInRadius(d.x, d.y, size) & PATH_MAP_PASSABLE)) {
 		// If the desired target is blocked, find the path
 		// to the nearest reachable point.
@@ -264,30 +296,124 @@ PathNode *Map::FindPath(const Point &s, const Point &d, unsigned int size, unsig
 		// but stop just before it
 		AdjustPositionNavmap(nmptDest);
 	}
-	if (minDistance < size && !(GetBlockedInRadius(nmptDest.x, nmptDest.y, size) & (PATH_MAP_PASSABLE | PATH_MAP_ACTOR))) {
-		Log(DEBUG, "FindPath", "%s can't fit in destination", caller ? caller->GetName(0) : "nullptr");
+	return nmptDest;
+}
+
+// the search proper to nmptDest (see GetPathDestination), only touching the
+// given context and workspace, so the path workers can run several at once
+Path *Map::FindPath(const Point &s, const Point &d, const NavmapPoint &nmptDest, unsigned int size, unsigned int minDistance, int flags, const PathContext &ctx, PathWorkspace &ws) const
+{
+	StringBuffer buffer;
+	buffer.appendFormatted("s = (%d, %d), d = (%d, %d), caller = %s, dist = %d, size = %d", s.x, s.y, d.x, d.y, ctx.GetCallerName(), minDistance, size);
+	ctx.LogDebug("FindPath", buffer);
+	NavmapPoint nmptSource = s;
+	if (minDistance < size && !(ctx.GetSearchmap().GetBlockedInRadius(nmptDest.x, nmptDest.y, size) & (PATH_MAP_PASSABLE | PATH_MAP_ACTOR))) {
+		buffer.clear();
+		buffer.appendFormatted("%s can't fit in destination", ctx.GetCallerName());
+		ctx.LogDebug("FindPath", buffer);
 		return nullptr;
 	}
 	SearchmapPoint smptSource(nmptSource.x / 16, nmptSource.y / 12);
 	SearchmapPoint smptDest(nmptDest.x / 16, nmptDest.y / 12);
 	if (smptDest == smptSource) return nullptr;
 
+	bool foundPath = false;
+	// long routes are planned over the cluster graph first
+	if ((unsigned) std::max(std::abs(smptDest.x - smptSource.x), std::abs(smptDest.y - smptSource.y)) >= HPA_MIN_DISTANCE) {
+		foundPath = FindHierarchicalPath(nmptSource, nmptDest, d, size, minDistance, flags, ctx, ws);
+	}
+	if (!foundPath) {
+		foundPath = SearchPath(nmptSource, nmptDest, d, size, minDistance, flags, ctx, ws);
+	}
+
+	if (foundPath) {
+		return BuildPath(ws.route, flags);
+	}
+	buffer.clear();
+	buffer.appendFormatted("Pathing failed for %s", ctx.GetCallerName());
+	ctx.LogDebug("FindPath", buffer);
+
+	return nullptr;
+}
+
+// the path for a route given goal first, without its start
+Path *Map::BuildPath(const std::vector<NavmapPoint> &route, int flags) const
+{
+	if (route.size() < 2) return nullptr;
+
+	size_t length = route.size() - 1;
+	Path *path = new Path(length);
+	for (size_t i = 0; i < length; i++) {
+		const NavmapPoint &nmptStep = route[i];
+		const NavmapPoint &nmptParent = route[i + 1];
+		PathNode &step = (*path)[length - 1 - i];
+		step.x = nmptStep.x;
+		step.y = nmptStep.y;
+		if (flags & PF_BACKAWAY) {
+			step.orient = GetOrient(nmptParent, nmptStep);
+		} else {
+			step.orient = GetOrient(nmptStep, nmptParent);
+		}
+	}
+	return path;
+}
+
+// Follows the flow field from s down to its goal cell and then on to d,
+// which only has to be near the goal (eg. a place in the formation). The
+// cells are joined into straight legs wherever they are walkable, like the
+// Theta* parents are. Returns nullptr if an actor is in the way or d can't
+// be walked to, the caller does a proper search then.
+Path *Map::FindFlowPath(const Point &s, const Point &d, const FlowField &field, int flags, const PathContext &ctx, PathWorkspace &ws) const
+{
+	const SearchmapView &sm = ctx.GetSearchmap();
+	std::vector<SearchmapPoint> cells;
+	field.Trace(SearchmapPoint(s.x / 16, s.y / 12), cells);
+	std::vector<NavmapPoint> route(1, s);
+	for (size_t i = 1; i < cells.size(); i++) {
+		route.push_back(NavmapPoint(cells[i].x * 16 + 8, cells[i].y * 12 + 6));
+	}
+	if (route.size() > 1 && route.back().x / 16 == d.x / 16 && route.back().y / 12 == d.y / 12) {
+		route.back() = d;
+	} else {
+		route.push_back(d);
+	}
+
+	bool actorsAreBlocking = flags & PF_ACTORS_ARE_BLOCKING;
+	ws.route.assign(1, s);
+	for (size_t from = 0; from + 1 < route.size(); ) {
+		size_t to = from + 1;
+		if (!sm.IsWalkableTo(route[from], route[to], actorsAreBlocking, ctx.GetStepFactor())) {
+			return nullptr;
+		}
+		while (to + 1 < route.size() && sm.IsWalkableTo(route[from], route[to + 1], actorsAreBlocking, ctx.GetStepFactor())) {
+			to++;
+		}
+		ws.route.push_back(route[to]);
+		from = to;
+	}
+	std::reverse(ws.route.begin(), ws.route.end());
+	return BuildPath(ws.route, flags);
+}
+
+// Theta* search from s to d, leaving the route in the workspace, goal first
+bool Map::SearchPath(const NavmapPoint &nmptSource, NavmapPoint nmptDest, const Point &sightTarget, unsigned int size, unsigned int minDistance, int flags, const PathContext &ctx, PathWorkspace &ws) const
+{
+	const SearchmapView &sm = ctx.GetSearchmap();
+	double stepFactor = ctx.GetStepFactor();
+	SearchmapPoint smptSource(nmptSource.x / 16, nmptSource.y / 12);
+	SearchmapPoint smptDest(nmptDest.x / 16, nmptDest.y / 12);
+
 	// Initialize data structures
-	FibonacciHeap<PQNode> open;
-	std::vector<bool> isClosed(Width * Height, false);
-	std::vector<NavmapPoint> parents(Width * Height, Point(0, 0));
-	std::vector<unsigned short> distFromStart(Width * Height, std::numeric_limits<unsigned short>::max());
-	distFromStart[smptSource.y * Width + smptSource.x] = 0;
-	parents[smptSource.y * Width + smptSource.x] = nmptSource;
-	open.emplace(PQNode(nmptSource, 0));
+	ws.Reset(Width * Height);
+	ws.SetParent(smptSource.y * Width + smptSource.x, nmptSource, 0);
+	ws.Push(PQNode(nmptSource, 0));
 	bool foundPath = false;
 	unsigned int squaredMinDist = minDistance * minDistance;
 
-	while (!open.empty()) {
-		NavmapPoint nmptCurrent = open.top().point;
-		open.pop();
+	while (!ws.Empty()) {
+		NavmapPoint nmptCurrent = ws.Pop().point;
 		SearchmapPoint smptCurrent(nmptCurrent.x / 16, nmptCurrent.y / 12);
-		if (parents[smptCurrent.y * Width + smptCurrent.x] == Point(0, 0)) {
+		if (ws.GetParent(smptCurrent.y * Width + smptCurrent.x) == Point(0, 0)) {
 			continue;
 		}
 
@@ -296,9 +422,10 @@ PathNode *Map::FindPath(const Point &s, const Point &d, unsigned int size, unsig
 			foundPath = true;
 			break;
 		} else if (minDistance) {
-			if (parents[smptCurrent.y * Width + smptCurrent.x] != nmptCurrent &&
+			if (ws.GetParent(smptCurrent.y * Width + smptCurrent.x) != nmptCurrent &&
 					SquaredDistance(nmptCurrent, nmptDest) < squaredMinDist) {
-				if (!(flags & PF_SIGHT) || IsVisibleLOS(nmptCurrent, d)) {
+				// not IsVisibleLOS, its memo isn't shared with the path workers
+				if (!(flags & PF_SIGHT) || !(sm.GetBlockedInLine(nmptCurrent, sightTarget, false, 1) & PATH_MAP_SIDEWALL)) {
 					smptDest = smptCurrent;
 					nmptDest = nmptCurrent;
 					foundPath = true;
@@ -306,7 +433,7 @@ PathNode *Map::FindPath(const Point &s, const Point &d, unsigned int size, unsig
 				}
 			}
 		}
-		isClosed[smptCurrent.y * Width + smptCurrent.x] = true;
+		ws.Close(smptCurrent.y * Width + smptCurrent.x);
 
 		for (size_t i = 0; i < DEGREES_OF_FREEDOM; i++) {
 			NavmapPoint nmptChild(nmptCurrent.x + 16 * dxAdjacent[i], nmptCurrent.y + 12 * dyAdjacent[i]);
@@ -314,39 +441,39 @@ PathNode *Map::FindPath(const Point &s, const Point &d, unsigned int size, unsig
 			// Outside map
 			if (smptChild.x < 0 ||	smptChild.y < 0 || (unsigned) smptChild.x >= Width || (unsigned) smptChild.y >= Height) continue;
 			// Already visited
-			if (isClosed[smptChild.y * Width + smptChild.x]) continue;
+			if (ws.IsClosed(smptChild.y * Width + smptChild.x)) continue;
 			// If there's an actor, check it can be bumped away
-			Actor* childActor = GetActor(nmptChild, GA_NO_DEAD|GA_NO_UNSCHEDULED);
-			bool childIsUnbumpable = childActor && childActor != caller && (flags & PF_ACTORS_ARE_BLOCKING || !childActor->ValidTarget(GA_ONLY_BUMPABLE));
-			if (childIsUnbumpable) continue;
+			if (ctx.IsActorInTheWay(nmptChild, flags & PF_ACTORS_ARE_BLOCKING)) continue;
 
-			unsigned childBlockStatus = GetBlockedInRadius(nmptChild.x, nmptChild.y, size);
+			unsigned childBlockStatus = sm.GetBlockedInRadius(nmptChild.x, nmptChild.y, size);
 			bool childBlocked = !(childBlockStatus & (PATH_MAP_PASSABLE | PATH_MAP_ACTOR | PATH_MAP_TRAVEL));
 			if (childBlocked) continue;
 
 			// Weighted heuristic. Finds sub-optimal paths but should be quite a bit faster
 			const float HEURISTIC_WEIGHT = 1.5;
 			SearchmapPoint smptCurrent(nmptCurrent.x / 16, nmptCurrent.y / 12);
-			NavmapPoint nmptParent = parents[smptCurrent.y * Width + smptCurrent.x];
-			unsigned short oldDist = distFromStart[smptChild.y * Width + smptChild.x];
+			size_t childIdx = smptChild.y * Width + smptChild.x;
+			NavmapPoint nmptParent = ws.GetParent(smptCurrent.y * Width + smptCurrent.x);
+			unsigned short oldDist = ws.GetDistance(childIdx);
+			unsigned short childDist = oldDist;
 			// Theta-star path if there is LOS
-			if (IsWalkableTo(nmptParent, nmptChild, flags & PF_ACTORS_ARE_BLOCKING, caller)) {
+			if (sm.IsWalkableTo(nmptParent, nmptChild, flags & PF_ACTORS_ARE_BLOCKING, stepFactor)) {
 				SearchmapPoint smptParent(nmptParent.x / 16, nmptParent.y / 12);
-				unsigned short newDist = distFromStart[smptParent.y * Width + smptParent.x] + Distance(smptParent, smptChild);
+				unsigned short newDist = ws.GetDistance(smptParent.y * Width + smptParent.x) + Distance(smptParent, smptChild);
 				if (newDist < oldDist) {
-					parents[smptChild.y * Width + smptChild.x] = nmptParent;
-					distFromStart[smptChild.y * Width + smptChild.x] = newDist;
+					ws.SetParent(childIdx, nmptParent, newDist);
+					childDist = newDist;
 				}
 			// Fall back to A-star path
-			} else if (IsWalkableTo(nmptCurrent, nmptChild, flags & PF_ACTORS_ARE_BLOCKING, caller)) {
-				unsigned short newDist = distFromStart[smptCurrent.y * Width + smptCurrent.x] + Distance(smptCurrent, smptChild);
+			} else if (sm.IsWalkableTo(nmptCurrent, nmptChild, flags & PF_ACTORS_ARE_BLOCKING, stepFactor)) {
+				unsigned short newDist = ws.GetDistance(smptCurrent.y * Width + smptCurrent.x) + Distance(smptCurrent, smptChild);
 				if (newDist < oldDist) {
-					parents[smptChild.y * Width + smptChild.x] = nmptCurrent;
-					distFromStart[smptChild.y * Width + smptChild.x] = newDist;
+					ws.SetParent(childIdx, nmptCurrent, newDist);
+					childDist = newDist;
 				}
 			}
 
-			if (distFromStart[smptChild.y * Width + smptChild.x] < oldDist) {
+			if (childDist < oldDist) {
 				// Calculate heuristic
 				int xDist = smptChild.x - smptDest.x;
 				int yDist = smptChild.y - smptDest.y;
@@ -356,47 +483,575 @@ PathNode *Map::FindPath(const Point &s, const Point &d, unsigned int size, unsig
 				int crossProduct = std::abs(xDist * dyCross - yDist * dxCross) >> 3;
 				double distance = std::sqrt(xDist * xDist + yDist * yDist);
 				double heuristic = HEURISTIC_WEIGHT * (distance + crossProduct);
-				double estDist = distFromStart[smptChild.y * Width + smptChild.x] + heuristic;
-				PQNode newNode(nmptChild, estDist);
-				open.emplace(newNode);
+				double estDist = childDist + heuristic;
+				ws.Push(PQNode(nmptChild, estDist));
 			}
 		}
 	}
 
 	if (foundPath) {
-		PathNode *resultPath = nullptr;
+		// walk back to the start into the contiguous route
 		NavmapPoint nmptCurrent = nmptDest;
-		NavmapPoint nmptParent;
 		SearchmapPoint smptCurrent(nmptCurrent.x / 16, nmptCurrent.y / 12);
-		while (!resultPath || nmptCurrent != parents[smptCurrent.y * Width + smptCurrent.x]) {
-			nmptParent = parents[smptCurrent.y * Width + smptCurrent.x];
-			PathNode *newStep = new PathNode;
-			newStep->x = nmptCurrent.x;
-			newStep->y = nmptCurrent.y;
-			newStep->Next = resultPath;
-			newStep->Parent = nullptr;
-			if (flags & PF_BACKAWAY) {
-				newStep->orient = GetOrient(nmptParent, nmptCurrent);
+		do {
+			ws.route.push_back(nmptCurrent);
+			nmptCurrent = ws.GetParent(smptCurrent.y * Width + smptCurrent.x);
+			smptCurrent.x = nmptCurrent.x / 16;
+			smptCurrent.y = nmptCurrent.y / 12;
+		} while (nmptCurrent != ws.GetParent(smptCurrent.y * Width + smptCurrent.x));
+		ws.route.push_back(nmptCurrent);
+	}
+	return foundPath;
+}
+
+// Plans the route over the cluster graph, then only searches the map from one
+// cluster entrance to the next, leaving the route in the workspace, goal first
+bool Map::FindHierarchicalPath(const NavmapPoint &nmptSource, const NavmapPoint &nmptDest, const Point &sightTarget, unsigned int size, unsigned int minDistance, int flags, const PathContext &ctx, PathWorkspace &ws) const
+{
+	SearchmapPoint smptSource(nmptSource.x / 16, nmptSource.y / 12);
+	SearchmapPoint smptDest(nmptDest.x / 16, nmptDest.y / 12);
+	std::vector<SearchmapPoint> waypoints;
+	if (!ctx.GetPathAbstraction(size)->FindRoute(smptSource, smptDest, waypoints, ws.abstractSearch) || waypoints.empty()) {
+		return false;
+	}
+
+	std::vector<NavmapPoint> route(1, nmptSource);
+	std::vector<size_t> joints;
+	for (size_t i = 0; i <= waypoints.size(); i++) {
+		bool last = i == waypoints.size();
+		NavmapPoint nmptStep = nmptDest;
+		if (!last) {
+			nmptStep.x = waypoints[i].x * 16 + 8;
+			nmptStep.y = waypoints[i].y * 12 + 6;
+		}
+		const NavmapPoint &nmptFrom = route.back();
+		if (nmptFrom.x / 16 == nmptStep.x / 16 && nmptFrom.y / 12 == nmptStep.y / 12) continue;
+		// an actor may block an entrance, the caller falls back to a full search
+		if (!SearchPath(nmptFrom, nmptStep, sightTarget, size, last ? minDistance : 0, flags, ctx, ws)) {
+			return false;
+		}
+		// the segment starts where the route ends so far
+		route.insert(route.end(), ws.route.rbegin() + 1, ws.route.rend());
+		if (!last) joints.push_back(route.size() - 1);
+	}
+
+	// cut the corners at the entrances where there is a straight way
+	for (size_t i = joints.size(); i--; ) {
+		size_t joint = joints[i];
+		if (joint + 1 < route.size() && ctx.GetSearchmap().IsWalkableTo(route[joint - 1], route[joint + 1], flags & PF_ACTORS_ARE_BLOCKING, ctx.GetStepFactor())) {
+			route.erase(route.begin() + joint);
+		}
+	}
+	ws.route.assign(route.rbegin(), route.rend());
+	return true;
+}
+
+// the searchmap cell offsets of the 8 neighbours, diagonals last
+static const int clusterDx[8] = { 1, 0, -1, 0, 1, -1, -1, 1 };
+static const int clusterDy[8] = { 0, 1, 0, -1, 1, 1, -1, -1 };
+
+// distance estimate in the units of the cluster searches
+static unsigned int OctileDistance(const Point &a, const Point &b)
+{
+	unsigned int dx = std::abs(a.x - b.x);
+	unsigned int dy = std::abs(a.y - b.y);
+	return HPA_STRAIGHT_COST * std::max(dx, dy) + (HPA_DIAGONAL_COST - HPA_STRAIGHT_COST) * std::min(dx, dy);
+}
+
+PathAbstraction::PathAbstraction(const Map *map, unsigned int size)
+{
+	this->map = map;
+	this->size = size;
+	width = map->GetWidth();
+	height = map->GetHeight();
+	clustersX = (width + HPA_CLUSTER_SIZE - 1) / HPA_CLUSTER_SIZE;
+	clustersY = (height + HPA_CLUSTER_SIZE - 1) / HPA_CLUSTER_SIZE;
+	passable.resize(width * height);
+	clusters.resize(clustersX * clustersY);
+	for (unsigned int i = 0; i < clusters.size(); i++) {
+		Cluster &cluster = clusters[i];
+		cluster.origin.x = (i % clustersX) * HPA_CLUSTER_SIZE;
+		cluster.origin.y = (i / clustersX) * HPA_CLUSTER_SIZE;
+		cluster.width = std::min(HPA_CLUSTER_SIZE, width - cluster.origin.x);
+		cluster.height = std::min(HPA_CLUSTER_SIZE, height - cluster.origin.y);
+		cluster.dirty = true;
+		cluster.stale = true;
+	}
+	borders.resize(2 * clusters.size());
+	bordersDirty.assign(2 * clusters.size(), true);
+	dirty = true;
+}
+
+void PathAbstraction::Invalidate(int x1, int y1, int x2, int y2)
+{
+	// a cell is passable if there is nothing in the circle around it
+	int reach = size - 2;
+	x1 = std::max(x1 - reach, 0);
+	y1 = std::max(y1 - reach, 0);
+	x2 = std::min(x2 + reach, (int) width - 1);
+	y2 = std::min(y2 + reach, (int) height - 1);
+	for (int cy = y1 / HPA_CLUSTER_SIZE; cy <= y2 / (int) HPA_CLUSTER_SIZE; cy++) {
+		for (int cx = x1 / HPA_CLUSTER_SIZE; cx <= x2 / (int) HPA_CLUSTER_SIZE; cx++) {
+			clusters[cy * clustersX + cx].dirty = true;
+			dirty = true;
+		}
+	}
+}
+
+// rebuilds the changed clusters, their borders and neighbours
+void PathAbstraction::Refresh()
+{
+	if (!dirty) return;
+	dirty = false;
+
+	for (unsigned int i = 0; i < clusters.size(); i++) {
+		if (!clusters[i].dirty) continue;
+		UpdatePassability(clusters[i]);
+		clusters[i].dirty = false;
+		bordersDirty[2 * i] = true;
+		bordersDirty[2 * i + 1] = true;
+		if (i % clustersX) bordersDirty[2 * (i - 1)] = true;
+		if (i >= clustersX) bordersDirty[2 * (i - clustersX) + 1] = true;
+	}
+	for (unsigned int i = 0; i < borders.size(); i++) {
+		if (!bordersDirty[i]) continue;
+		RebuildBorder(i / 2, i & 1);
+		bordersDirty[i] = false;
+	}
+	for (unsigned int i = 0; i < clusters.size(); i++) {
+		if (clusters[i].stale) {
+			RebuildDistances(i);
+		}
+	}
+}
+
+void PathAbstraction::UpdatePassability(const Cluster &cluster)
+{
+	for (unsigned int y = cluster.origin.y; y < cluster.origin.y + cluster.height; y++) {
+		for (unsigned int x = cluster.origin.x; x < cluster.origin.x + cluster.width; x++) {
+			passable[y * width + x] = map->IsPassableTerrain(x, y, size);
+		}
+	}
+}
+
+// finds the runs of passable cells on both sides of the right (or bottom)
+// border of the cluster, long runs get an entrance at each end
+void PathAbstraction::RebuildBorder(unsigned int cluster, bool bottom)
+{
+	std::vector<int> &border = borders[2 * cluster + bottom];
+	for (size_t i = 0; i < border.size(); i++) {
+		freeNodes.push_back(border[i]);
+	}
+	border.clear();
+
+	unsigned int neighbour = cluster + (bottom ? clustersX : 1);
+	if (bottom ? cluster / clustersX == clustersY - 1 : cluster % clustersX == clustersX - 1) {
+		return;
+	}
+	const Cluster &own = clusters[cluster];
+	clusters[cluster].stale = true;
+	clusters[neighbour].stale = true;
+
+	unsigned int length = bottom ? own.width : own.height;
+	unsigned int runStart = 0;
+	bool inRun = false;
+	for (unsigned int i = 0; i <= length; i++) {
+		Point cell = own.origin;
+		if (bottom) {
+			cell.x += i;
+			cell.y += own.height - 1;
+		} else {
+			cell.x += own.width - 1;
+			cell.y += i;
+		}
+		bool open = i < length && IsPassable(cell.x, cell.y) && IsPassable(cell.x + !bottom, cell.y + bottom);
+		if (open && !inRun) {
+			runStart = i;
+			inRun = true;
+		}
+		if (open || !inRun) continue;
+
+		inRun = false;
+		unsigned int runEnd = i - 1;
+		unsigned int entrances[2] = { (runStart + runEnd) / 2, runEnd };
+		unsigned int count = 1;
+		if (runEnd - runStart + 1 >= HPA_ENTRANCE_SPLIT) {
+			entrances[0] = runStart;
+			count = 2;
+		}
+		for (unsigned int j = 0; j < count; j++) {
+			Point inside = own.origin;
+			if (bottom) {
+				inside.x += entrances[j];
+				inside.y += own.height - 1;
 			} else {
-				newStep->orient = GetOrient(nmptCurrent, nmptParent);
+				inside.x += own.width - 1;
+				inside.y += entrances[j];
 			}
-			if (resultPath) {
-				resultPath->Parent = newStep;
-			}
-			resultPath = newStep;
-			nmptCurrent = nmptParent;
+			Point outside(inside.x + !bottom, inside.y + bottom);
+			int first = NewNode(inside, cluster);
+			int second = NewNode(outside, neighbour);
+			nodes[first].partner = second;
+			nodes[second].partner = first;
+			border.push_back(first);
+			border.push_back(second);
+		}
+	}
+}
 
-			smptCurrent.x = nmptCurrent.x / 16;
-			smptCurrent.y = nmptCurrent.y / 12;
+// collects the entrances of the cluster and the distances between them
+void PathAbstraction::RebuildDistances(unsigned int cluster)
+{
+	Cluster &own = clusters[cluster];
+	own.stale = false;
+	own.nodes.clear();
+	// this side of the own borders, the far side of the neighbours'
+	const std::vector<int> *sides[4] = { &borders[2 * cluster], &borders[2 * cluster + 1], NULL, NULL };
+	if (cluster % clustersX) sides[2] = &borders[2 * (cluster - 1)];
+	if (cluster >= clustersX) sides[3] = &borders[2 * (cluster - clustersX) + 1];
+	for (unsigned int side = 0; side < 4; side++) {
+		if (!sides[side]) continue;
+		for (size_t i = side < 2 ? 0 : 1; i < sides[side]->size(); i += 2) {
+			int node = (*sides[side])[i];
+			nodes[node].slot = own.nodes.size();
+			own.nodes.push_back(node);
+		}
+	}
+
+	size_t count = own.nodes.size();
+	own.distances.assign(count * count, std::numeric_limits<unsigned int>::max());
+	std::vector<unsigned int> flood;
+	for (size_t i = 0; i < count; i++) {
+		Flood(own, nodes[own.nodes[i]].cell, flood);
+		for (size_t j = 0; j < count; j++) {
+			const Point &cell = nodes[own.nodes[j]].cell;
+			own.distances[i * count + j] = flood[(cell.y - own.origin.y) * own.width + cell.x - own.origin.x];
+		}
+	}
+}
+
+// Dijkstra within the cluster, 8 connected without cutting corners
+void PathAbstraction::Flood(const Cluster &cluster, const Point &from, std::vector<unsigned int> &distances) const
+{
+	const unsigned int unreached = std::numeric_limits<unsigned int>::max();
+	distances.assign(cluster.width * cluster.height, unreached);
+	if (!IsPassable(from.x, from.y)) return;
+
+	typedef std::pair<unsigned int, unsigned int> Entry;
+	std::vector<Entry> heap;
+	unsigned int start = (from.y - cluster.origin.y) * cluster.width + from.x - cluster.origin.x;
+	distances[start] = 0;
+	heap.push_back(Entry(0, start));
+	while (!heap.empty()) {
+		std::pop_heap(heap.begin(), heap.end(), std::greater<Entry>());
+		Entry entry = heap.back();
+		heap.pop_back();
+		if (entry.first > distances[entry.second]) continue;
+
+		int x = entry.second % cluster.width;
+		int y = entry.second / cluster.width;
+		for (int i = 0; i < 8; i++) {
+			int nx = x + clusterDx[i];
+			int ny = y + clusterDy[i];
+			if (nx < 0 || ny < 0 || nx >= (int) cluster.width || ny >= (int) cluster.height) continue;
+			if (!IsPassable(cluster.origin.x + nx, cluster.origin.y + ny)) continue;
+			bool diagonal = i >= 4;
+			if (diagonal && (!IsPassable(cluster.origin.x + nx, cluster.origin.y + y) || !IsPassable(cluster.origin.x + x, cluster.origin.y + ny))) continue;
+
+			unsigned int distance = entry.first + (diagonal ? HPA_DIAGONAL_COST : HPA_STRAIGHT_COST);
+			unsigned int idx = ny * cluster.width + nx;
+			if (distance < distances[idx]) {
+				distances[idx] = distance;
+				heap.push_back(Entry(distance, idx));
+				std::push_heap(heap.begin(), heap.end(), std::greater<Entry>());
+			}
 		}
-		return resultPath;
-	} else if (caller) {
-		Log(DEBUG, "FindPath", "Pathing failed for %s", caller->GetName(0));
+	}
+}
+
+bool PathAbstraction::IsPassable(int x, int y) const
+{
+	if (x < 0 || y < 0 || (unsigned) x >= width || (unsigned) y >= height) {
+		return false;
+	}
+	return passable[y * width + x];
+}
+
+int PathAbstraction::NewNode(const Point &cell, unsigned int cluster)
+{
+	int node;
+	if (freeNodes.empty()) {
+		node = nodes.size();
+		nodes.push_back(Node());
 	} else {
-		Log(DEBUG, "FindPath", "Pathing failed");
+		node = freeNodes.back();
+		freeNodes.pop_back();
 	}
+	nodes[node].cell = cell;
+	nodes[node].cluster = cluster;
+	return node;
+}
 
-	return nullptr;
+// queues the node unless it was already reached cheaper
+void PathAbstraction::Reach(AbstractSearch &search, int node, unsigned int cost, int parent, const Point &cell, const Point &goal) const
+{
+	if (search.stamps[node] == search.generation && search.costs[node] <= cost) return;
+	search.stamps[node] = search.generation;
+	search.costs[node] = cost;
+	search.parents[node] = parent;
+	search.open.push_back(std::make_pair(cost + OctileDistance(cell, goal), node));
+	std::push_heap(search.open.begin(), search.open.end(), std::greater<std::pair<unsigned int, int> >());
+}
+
+unsigned int PathAbstraction::ClusterAt(const Point &cell) const
+{
+	return (cell.y / HPA_CLUSTER_SIZE) * clustersX + cell.x / HPA_CLUSTER_SIZE;
+}
+
+// A* over the entrances, with the start and goal cells
+// connected to the entrances of their clusters
+bool PathAbstraction::FindRoute(const Point &start, const Point &goal, std::vector<Point> &waypoints, AbstractSearch &search) const
+{
+	waypoints.clear();
+	if (!IsPassable(start.x, start.y) || !IsPassable(goal.x, goal.y)) {
+		return false;
+	}
+
+	const unsigned int unreached = std::numeric_limits<unsigned int>::max();
+	unsigned int startCluster = ClusterAt(start);
+	unsigned int goalCluster = ClusterAt(goal);
+	const Cluster &first = clusters[startCluster];
+	std::vector<unsigned int> &startDistances = search.startDistances;
+	std::vector<unsigned int> &goalDistances = search.goalDistances;
+	Flood(first, start, startDistances);
+	Flood(clusters[goalCluster], goal, goalDistances);
+
+	// the goal is the node after the last entrance
+	int goalNode = nodes.size();
+	if (search.stamps.size() != nodes.size() + 1) {
+		search.stamps.assign(nodes.size() + 1, 0);
+		search.costs.resize(nodes.size() + 1);
+		search.parents.resize(nodes.size() + 1);
+		search.generation = 0;
+	}
+	if (!++search.generation) {
+		std::fill(search.stamps.begin(), search.stamps.end(), 0);
+		search.generation = 1;
+	}
+	std::vector<std::pair<unsigned int, int> > &open = search.open;
+	std::vector<unsigned int> &costs = search.costs;
+	std::vector<int> &parents = search.parents;
+	open.clear();
+
+	// the start itself is no node, what it reaches is queued right away
+	for (size_t i = 0; i < first.nodes.size(); i++) {
+		const Point &cell = nodes[first.nodes[i]].cell;
+		unsigned int cost = startDistances[(cell.y - first.origin.y) * first.width + cell.x - first.origin.x];
+		if (cost != unreached) {
+			Reach(search, first.nodes[i], cost, -1, cell, goal);
+		}
+	}
+	if (startCluster == goalCluster) {
+		unsigned int cost = startDistances[(goal.y - first.origin.y) * first.width + goal.x - first.origin.x];
+		if (cost != unreached) {
+			Reach(search, goalNode, cost, -1, goal, goal);
+		}
+	}
+
+	while (!open.empty()) {
+		std::pop_heap(open.begin(), open.end(), std::greater<std::pair<unsigned int, int> >());
+		int current = open.back().second;
+		unsigned int estimate = open.back().first;
+		open.pop_back();
+		if (current == goalNode) {
+			// only keep the first entrance of each cluster on the way
+			for (int node = parents[goalNode]; node != -1; node = parents[node]) {
+				if (parents[node] != -1 && nodes[parents[node]].partner == node) {
+					waypoints.push_back(nodes[node].cell);
+				}
+			}
+			std::reverse(waypoints.begin(), waypoints.end());
+			return true;
+		}
+		const Node &node = nodes[current];
+		// already expanded through a cheaper way
+		if (estimate > costs[current] + OctileDistance(node.cell, goal)) continue;
+
+		const Cluster &cluster = clusters[node.cluster];
+		size_t count = cluster.nodes.size();
+		// the other entrances, the other side of the border and the goal itself
+		for (size_t i = 0; i < count + 2; i++) {
+			int next;
+			unsigned int step;
+			if (i < count) {
+				next = cluster.nodes[i];
+				step = cluster.distances[node.slot * count + i];
+				if (next == current) continue;
+			} else if (i == count) {
+				next = node.partner;
+				step = HPA_STRAIGHT_COST;
+			} else {
+				if (node.cluster != goalCluster) continue;
+				next = goalNode;
+				step = goalDistances[(node.cell.y - cluster.origin.y) * cluster.width + node.cell.x - cluster.origin.x];
+			}
+			if (step == unreached) continue;
+
+			Reach(search, next, costs[current] + step, current, next == goalNode ? goal : nodes[next].cell, goal);
+		}
+	}
+	return false;
+}
+
+FlowField::FlowField(const Map *map, const Point &goal, unsigned int size, unsigned long time, unsigned long generation)
+	: map(map), goal(goal), size(size), time(time), generation(generation)
+{
+	width = map->GetWidth();
+	height = map->GetHeight();
+	costs.assign(width * height, std::numeric_limits<unsigned int>::max());
+	towards.assign(width * height, 0);
+	settled.assign(width * height, 0);
+	passable.assign(width * height, 0);
+	// more than a step ever costs, so the queued costs never share a bucket
+	buckets.resize(16);
+	frontier = 0;
+	queued = 0;
+	if (IsPassable(goal.x, goal.y)) {
+		unsigned int idx = goal.y * width + goal.x;
+		costs[idx] = 0;
+		buckets[0].push_back(idx);
+		queued++;
+	}
+}
+
+// looked up the first time the search reaches the cell, so a field only
+// pays for the cells around the route instead of the whole map
+bool FlowField::IsPassable(int x, int y)
+{
+	if (x < 0 || y < 0 || (unsigned) x >= width || (unsigned) y >= height) {
+		return false;
+	}
+	unsigned char &state = passable[y * width + x];
+	if (!state) {
+		state = map->IsPassableTerrain(x, y, size) ? 2 : 1;
+	}
+	return state == 2;
+}
+
+// the Dijkstra search of PathAbstraction::Flood over the whole map,
+// stopping as soon as the start is settled
+bool FlowField::Reach(const Point &start)
+{
+	if (!IsPassable(start.x, start.y)) {
+		return false;
+	}
+	unsigned int target = start.y * width + start.x;
+	while (!settled[target] && queued) {
+		std::vector<unsigned int> &bucket = buckets[frontier & 15];
+		if (bucket.empty()) {
+			frontier++;
+			continue;
+		}
+		unsigned int current = bucket.back();
+		bucket.pop_back();
+		queued--;
+		if (settled[current] || costs[current] != frontier) continue;
+		settled[current] = 1;
+
+		int x = current % width;
+		int y = current / width;
+		for (int i = 0; i < 8; i++) {
+			int nx = x + clusterDx[i];
+			int ny = y + clusterDy[i];
+			if (!IsPassable(nx, ny)) continue;
+			bool diagonal = i >= 4;
+			if (diagonal && (!IsPassable(nx, y) || !IsPassable(x, ny))) continue;
+
+			unsigned int cost = frontier + (diagonal ? HPA_DIAGONAL_COST : HPA_STRAIGHT_COST);
+			unsigned int idx = ny * width + nx;
+			if (cost < costs[idx]) {
+				costs[idx] = cost;
+				towards[idx] = i + 1;
+				buckets[cost & 15].push_back(idx);
+				queued++;
+			}
+		}
+	}
+	return settled[target];
+}
+
+void FlowField::Trace(const Point &start, std::vector<Point> &cells) const
+{
+	Point cell = start;
+	cells.push_back(cell);
+	// every settled cell was reached from a settled one closer to the goal
+	while (cell != goal) {
+		int dir = towards[cell.y * width + cell.x] - 1;
+		cell.x -= clusterDx[dir];
+		cell.y -= clusterDy[dir];
+		cells.push_back(cell);
+	}
+}
+
+PathWorkers::PathWorkers(size_t count)
+: workspaces(count)
+{
+	for (size_t t = 0; t < count; t++) {
+		threads.emplace_back(&PathWorkers::Run, this, t);
+	}
+}
+
+PathWorkers::~PathWorkers()
+{
+	{
+		std::lock_guard<std::mutex> l(lock);
+		stop = true;
+	}
+	wake.notify_all();
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+}
+
+void PathWorkers::Start(size_t count, std::function<void(size_t, PathWorkspace &)> newJob)
+{
+	{
+		std::lock_guard<std::mutex> l(lock);
+		job = std::move(newJob);
+		jobCount = count;
+		nextJob = 0;
+		jobsLeft = count;
+	}
+	wake.notify_all();
+}
+
+bool PathWorkers::IsDone()
+{
+	std::lock_guard<std::mutex> l(lock);
+	return !jobsLeft;
+}
+
+void PathWorkers::Wait()
+{
+	std::unique_lock<std::mutex> l(lock);
+	finished.wait(l, [this] { return !jobsLeft; });
+}
+
+void PathWorkers::Run(size_t thread)
+{
+	std::unique_lock<std::mutex> l(lock);
+	while (true) {
+		wake.wait(l, [this] { return stop || nextJob < jobCount; });
+		if (stop) return;
+
+		size_t i = nextJob++;
+		l.unlock();
+		job(i, workspaces[thread]);
+		l.lock();
+		if (!--jobsLeft) {
+			finished.notify_all();
+		}
+	}
 }
 
 void Map::NormalizeDeltas(double &dx, double &dy, const double &factor)
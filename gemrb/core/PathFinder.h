@@ -20,8 +20,23 @@
 #ifndef PATHFINDER_H
 #define PATHFINDER_H
 
+#include "exports.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
 namespace GemRB {
 
+class StringBuffer;
+
 //searchmap conversion bits
 
 enum {
@@ -51,9 +66,46 @@ struct PathNode {
 	unsigned int orient;
 };
 
+// A whole path in one buffer, first step first. The nodes stay linked to
+// each other, so code walking a PathNode list (the actions, the debug
+// drawing) can simply start at Front()
+class Path {
+public:
+	explicit Path(size_t length) : nodes(length) { Link(); }
+
+	PathNode *Front() { return &nodes.front(); }
+	PathNode *Back() { return &nodes.back(); }
+	PathNode &operator[](size_t i) { return nodes[i]; }
+	size_t GetLength() const { return nodes.size(); }
+	size_t IndexOf(const PathNode *node) const { return node - nodes.data(); }
+
+	// adds the steps of another path; the buffer may move, so any
+	// pointers to the old nodes have to be looked up again by index
+	void Append(const Path &other)
+	{
+		nodes.insert(nodes.end(), other.nodes.begin(), other.nodes.end());
+		Link();
+	}
+
+private:
+	void Link()
+	{
+		for (size_t i = 0; i < nodes.size(); i++) {
+			nodes[i].Parent = i ? &nodes[i - 1] : nullptr;
+			nodes[i].Next = i + 1 < nodes.size() ? &nodes[i + 1] : nullptr;
+		}
+	}
+
+	std::vector<PathNode> nodes;
+};
+
 typedef Point NavmapPoint;
 typedef Point SearchmapPoint;
 
+class FlowField;
+class Map;
+class PathAbstraction;
+
 enum {
 	PF_SIGHT = 1,
 	PF_BACKAWAY = 2,
@@ -80,6 +132,307 @@ public:
 
 };
 
+// Read access to a searchmap, its clearance maps and actor mark counts,
+// either the live ones of a Map or the copies in a SearchmapSnapshot
+class GEM_EXPORT SearchmapView {
+public:
+	unsigned int GetBlocked(unsigned int x, unsigned int y) const;
+	unsigned int GetBlockedNavmap(unsigned int x, unsigned int y) const { return GetBlocked(x / 16, y / 12); }
+	unsigned int GetBlockedInRadius(unsigned int px, unsigned int py, unsigned int size, bool stopOnImpassable = true) const;
+	// stepFactor is the walking step of the caller, for the sampled lines
+	unsigned int GetBlockedInLine(const Point &s, const Point &d, bool stopOnImpassable, double stepFactor) const;
+	unsigned int GetBlockedInSampledLine(const Point &s, const Point &d, bool stopOnImpassable, double stepFactor) const;
+	bool IsWalkableTo(const Point &s, const Point &d, bool actorsAreBlocking, double stepFactor) const;
+	bool IsPassableTerrain(unsigned int x, unsigned int y, unsigned int size) const;
+	bool ActorMarksNear(unsigned int x, unsigned int y, unsigned int radius) const;
+
+	const unsigned short *cells = nullptr;
+	const unsigned char *impassableClearance = nullptr;
+	const unsigned char *terrainClearance = nullptr;
+	const unsigned char *actorMarks = nullptr;
+	unsigned int width = 0, height = 0;
+	unsigned int actorMarksWidth = 0;
+	bool sampledLines = false;
+};
+
+// What a search reads besides its workspace. The main thread searches the
+// live map, the path workers the snapshot taken when their requests were
+// handed out, so they never see the area change under them.
+class PathContext {
+public:
+	virtual ~PathContext() {}
+	virtual const SearchmapView &GetSearchmap() const = 0;
+	// whether an actor other than the caller stands on p and can't be bumped away
+	virtual bool IsActorInTheWay(const Point &p, bool actorsAreBlocking) const = 0;
+	// the up to date cluster graph for the size
+	virtual const PathAbstraction *GetPathAbstraction(unsigned int size) const = 0;
+	virtual double GetStepFactor() const = 0;
+	virtual const char *GetCallerName() const = 0;
+	// the logger touches the gui, so the path workers keep their messages for the main thread
+	virtual void LogDebug(const char *owner, const StringBuffer &message) const = 0;
+};
+
+// Scratch state of a route search over a PathAbstraction
+struct AbstractSearch {
+	std::vector<unsigned int> stamps;
+	std::vector<unsigned int> costs;
+	std::vector<int> parents;
+	std::vector<std::pair<unsigned int, int> > open;
+	unsigned int generation = 0;
+	std::vector<unsigned int> startDistances;
+	std::vector<unsigned int> goalDistances;
+};
+
+// Scratch state of a search, kept between FindPath calls, so a search
+// neither allocates nor has to clear the per-cell arrays: the data of a
+// cell is only valid if its stamp matches the current generation
+class PathWorkspace {
+public:
+	// start a new search over a map of the given cell count
+	void Reset(size_t cells)
+	{
+		if (stamps.size() != cells) {
+			stamps.assign(cells, 0);
+			closed.assign(cells, 0);
+			parents.resize(cells);
+			distances.resize(cells);
+			generation = 0;
+		}
+		if (!++generation) {
+			// wrapped around, old stamps could match again
+			std::fill(stamps.begin(), stamps.end(), 0);
+			std::fill(closed.begin(), closed.end(), 0);
+			generation = 1;
+		}
+		open.clear();
+		route.clear();
+	}
+
+	bool IsClosed(size_t idx) const { return closed[idx] == generation; }
+	void Close(size_t idx) { closed[idx] = generation; }
+
+	Point GetParent(size_t idx) const
+	{
+		return stamps[idx] == generation ? parents[idx] : Point(0, 0);
+	}
+	unsigned short GetDistance(size_t idx) const
+	{
+		return stamps[idx] == generation ? distances[idx] : std::numeric_limits<unsigned short>::max();
+	}
+	void SetParent(size_t idx, const Point &parent, unsigned short distance)
+	{
+		stamps[idx] = generation;
+		parents[idx] = parent;
+		distances[idx] = distance;
+	}
+
+	// binary min-heap on a reused vector
+	bool Empty() const { return open.empty(); }
+	void Push(const PQNode &node)
+	{
+		open.push_back(node);
+		std::push_heap(open.begin(), open.end(), std::greater<PQNode>());
+	}
+	PQNode Pop()
+	{
+		std::pop_heap(open.begin(), open.end(), std::greater<PQNode>());
+		PQNode node = open.back();
+		open.pop_back();
+		return node;
+	}
+
+	// the found path, goal first
+	std::vector<Point> route;
+	AbstractSearch abstractSearch;
+
+private:
+	std::vector<unsigned int> stamps;
+	std::vector<unsigned int> closed;
+	std::vector<Point> parents;
+	std::vector<unsigned short> distances;
+	std::vector<PQNode> open;
+	unsigned int generation = 0;
+};
+
+// Cluster based abstraction of the searchmap for long routes (HPA*, see
+// Botea et al., 2004). The searchmap is cut into square clusters, the runs
+// of passable cells along each cluster border become entrances and the
+// distances between the entrances of a cluster are precomputed, so a long
+// search only has to cross this small graph. Every abstraction is built
+// for a single actor size and ignores the actors themselves.
+class PathAbstraction {
+public:
+	PathAbstraction(const Map *map, unsigned int size);
+
+	// the terrain changed in the given searchmap rectangle
+	void Invalidate(int x1, int y1, int x2, int y2);
+	// brings the changed clusters up to date, needed before FindRoute
+	void Refresh();
+	bool IsDirty() const { return dirty; }
+	// the entrance cells to pass between the start and goal cells, the
+	// first one of each cluster entered; false if there is no route
+	bool FindRoute(const Point &start, const Point &goal, std::vector<Point> &waypoints, AbstractSearch &search) const;
+
+private:
+	struct Node {
+		Point cell;
+		unsigned int cluster;
+		unsigned int slot; // index in the cluster's node list
+		int partner; // the node on the other side of the border
+	};
+	struct Cluster {
+		Point origin;
+		unsigned int width;
+		unsigned int height;
+		std::vector<int> nodes;
+		std::vector<unsigned int> distances; // between the nodes, row major
+		bool dirty; // the passability of the cells is outdated
+		bool stale; // the nodes or distances are outdated
+	};
+
+	void UpdatePassability(const Cluster &cluster);
+	void RebuildBorder(unsigned int cluster, bool bottom);
+	void RebuildDistances(unsigned int cluster);
+	void Flood(const Cluster &cluster, const Point &from, std::vector<unsigned int> &distances) const;
+	bool IsPassable(int x, int y) const;
+	int NewNode(const Point &cell, unsigned int cluster);
+	void Reach(AbstractSearch &search, int node, unsigned int cost, int parent, const Point &cell, const Point &goal) const;
+	unsigned int ClusterAt(const Point &cell) const;
+
+	const Map *map;
+	unsigned int size;
+	unsigned int width, height;
+	unsigned int clustersX, clustersY;
+	bool dirty;
+	std::vector<unsigned char> passable;
+	std::vector<Cluster> clusters;
+	// the node pairs along the right (even) and bottom (odd) border of each cluster
+	std::vector<std::vector<int> > borders;
+	std::vector<bool> bordersDirty;
+	std::vector<Node> nodes;
+	std::vector<int> freeNodes;
+};
+
+// Walking distances from every cell to a single goal cell (a flow field),
+// shared by all the movers heading there, eg. a party or a group of
+// monsters ordered to the same spot. The Dijkstra search from the goal is
+// only grown as far as the start cells of the movers need, so a later mover
+// starting further away simply resumes it. The step costs are small integers,
+// so the search uses a bucket queue instead of a heap. Like the PathAbstraction it is
+// built for a single actor size and ignores the actors themselves.
+class FlowField {
+public:
+	FlowField(const Map *map, const Point &goal, unsigned int size, unsigned long time, unsigned long generation);
+
+	// grows the field until the start cell is settled, false if it can't be reached
+	bool Reach(const Point &start);
+	// the cells from the (reached) start to the goal, each a step downhill;
+	// only reads the field, so the path workers can share it
+	void Trace(const Point &start, std::vector<Point> &cells) const;
+
+	const Point &GetGoal() const { return goal; }
+	unsigned int GetSize() const { return size; }
+	unsigned long GetTime() const { return time; }
+	unsigned long GetGeneration() const { return generation; }
+
+private:
+	bool IsPassable(int x, int y);
+
+	const Map *map;
+	Point goal;
+	unsigned int size;
+	unsigned long time;
+	unsigned long generation;
+	unsigned int width, height;
+	std::vector<unsigned int> costs;
+	// 1 + the direction the cell was reached from, 0 for the goal and unreached cells
+	std::vector<unsigned char> towards;
+	std::vector<unsigned char> settled;
+	// 0 until looked up, then 1 for blocked and 2 for passable cells
+	std::vector<unsigned char> passable;
+	// a bucket queue, the cells by their cost modulo the bucket count
+	std::vector<std::vector<unsigned int> > buckets;
+	unsigned int frontier;
+	unsigned int queued;
+};
+
+// What the searches need to know of an actor that may stand in the way
+struct SearchActor {
+	Point pos;
+	unsigned int size;
+	unsigned int id;
+	bool bumpable;
+};
+
+// A copy of the searchmap and the actors on it, taken when path requests
+// are handed to the workers; the buffers are reused by the next batch
+struct SearchmapSnapshot {
+	SearchmapView view; // over the copies below
+	std::vector<unsigned short> cells;
+	std::vector<unsigned char> impassableClearance;
+	std::vector<unsigned char> terrainClearance;
+	std::vector<unsigned char> actorMarks;
+	// in actor list order, bucketed like the actor grid of the map
+	std::vector<SearchActor> actors;
+	std::vector<std::vector<unsigned int> > actorGrid;
+	unsigned int actorGridWidth = 0, actorGridHeight = 0;
+	unsigned int actorMaxSize = 0;
+};
+
+// A queued path request, with everything the worker needs of the actor
+struct PathSearch {
+	unsigned int actorID;
+	std::string name;
+	Point start;
+	Point goal; // the destination when the request was handed out
+	Point dest; // the goal, moved off blocked cells
+	unsigned int size;
+	unsigned int minDistance;
+	bool canBump;
+	double stepFactor;
+	const FlowField *field;
+	Path *path;
+	// owner and text of the debug messages, logged when the batch is collected
+	std::vector<std::pair<std::string, std::string> > messages;
+};
+
+// The requests the path workers are searching, collected on a later update
+struct PathBatch {
+	SearchmapSnapshot snapshot;
+	std::vector<PathSearch> searches;
+	// refreshed when the batch was handed out, by size; the map copies
+	// them before changing one the batch still reads
+	std::vector<std::shared_ptr<PathAbstraction> > abstractions;
+	bool running = false;
+};
+
+// Threads kept for the whole life of a map, running the searches of a
+// PathBatch between the updates, each with its own workspace
+class PathWorkers {
+public:
+	explicit PathWorkers(size_t count);
+	~PathWorkers();
+
+	// runs job(i, workspace) for every i below count and returns at once
+	void Start(size_t count, std::function<void(size_t, PathWorkspace &)> job);
+	bool IsDone();
+	void Wait();
+
+private:
+	void Run(size_t thread);
+
+	std::vector<std::thread> threads;
+	std::vector<PathWorkspace> workspaces;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable finished;
+	std::function<void(size_t, PathWorkspace &)> job;
+	size_t jobCount = 0;
+	size_t nextJob = 0;
+	size_t jobsLeft = 0;
+	bool stop = false;
+};
+
 }
 
 #endif
@@ -29,13 +29,22 @@
 
 namespace GemRB {
 
+// the memo is simply dropped when it grows this big
+#define MEMO_LIMIT 32768
+
 ResourceManager::ResourceManager()
 {
+	memoCount = memoRevision = 0;
+	memoHits = memoMisses = 0;
+	memo.init(4096, 256);
 }
 
 
 ResourceManager::~ResourceManager()
 {
+	if (memoHits || memoMisses) {
+		Log(DEBUG, "ResourceManager", "Lookup memo: %u hits, %u misses.", memoHits, memoMisses);
+	}
 }
 
 bool ResourceManager::AddSource(const char *path, const char *description, PluginID type, int flags)
@@ -46,6 +55,7 @@ bool ResourceManager::AddSource(const char *path, const char *description, Plugi
 		return false;
 	}
 
+	std::lock_guard<std::mutex> l(memoLock);
 	if (flags & RM_REPLACE_SAME_SOURCE) {
 		for (size_t i = 0; i < searchPath.size(); i++) {
 			if (!stricmp(description, searchPath[i]->GetDescription())) {
@@ -56,9 +66,125 @@ bool ResourceManager::AddSource(const char *path, const char *description, Plugi
 	} else {
 		searchPath.push_back(source);
 	}
+	ResetMemo();
+	return true;
+}
+
+void ResourceManager::GetMemoStats(unsigned int &hits, unsigned int &misses) const
+{
+	std::lock_guard<std::mutex> l(memoLock);
+	hits = memoHits;
+	misses = memoMisses;
+}
+
+#define NO_SOURCE size_t(-1)
+
+// memo state of a single lookup over the search path
+struct ResourceManager::MemoLookup {
+	const ResourceManager *manager;
+	ResourceMemoKey key;
+	bool usable;
+	bool known;
+	size_t source;
+
+	MemoLookup(const ResourceManager *manager, const char *ResRef, SClass_ID type, const char *ext)
+		: manager(manager), usable(false), known(false), source(NO_SOURCE)
+	{
+		// longer names are passed straight to the sources
+		if (strnlen(ResRef, sizeof(ieResRef)) >= sizeof(ieResRef)) {
+			return;
+		}
+		strnlwrcpy(key.ref, ResRef, sizeof(ieResRef) - 1);
+		key.type = type;
+		key.ext = ext;
+		usable = true;
+		known = manager->LookupMemo(key, source);
+	}
+
+	/** Returns true if source i is known not to have the resource */
+	bool Skip(size_t i) const
+	{
+		return known && i != source && !manager->searchPath[i]->IsVolatile();
+	}
+
+	void Found(size_t i)
+	{
+		if (usable && !known && !manager->searchPath[i]->IsVolatile()) {
+			manager->SetMemo(key, i);
+		}
+	}
+
+	void NotFound(size_t i)
+	{
+		// the memo went stale, so continue without it
+		if (known && i == source) {
+			manager->ForgetMemo(key);
+			known = false;
+		}
+	}
+
+	void Missing()
+	{
+		if (usable && !known) {
+			manager->SetMemo(key, NO_SOURCE);
+		}
+	}
+
+	/** Stops using the memo for the rest of this lookup */
+	void Abandon()
+	{
+		usable = known = false;
+	}
+};
+
+bool ResourceManager::LookupMemo(const ResourceMemoKey &key, size_t &source) const
+{
+	std::lock_guard<std::mutex> l(memoLock);
+	// sources can reload their contents (eg. CachedDirectoryImporter::Refresh)
+	unsigned int revision = 0;
+	for (size_t i = 0; i < searchPath.size(); i++) {
+		revision += searchPath[i]->GetRevision();
+	}
+	if (revision != memoRevision) {
+		ResetMemo();
+		memoRevision = revision;
+	}
+
+	const size_t *memoized = memo.get(key);
+	if (!memoized) {
+		memoMisses++;
+		return false;
+	}
+	memoHits++;
+	source = *memoized;
 	return true;
 }
 
+void ResourceManager::SetMemo(const ResourceMemoKey &key, size_t source) const
+{
+	std::lock_guard<std::mutex> l(memoLock);
+	if (memoCount >= MEMO_LIMIT) {
+		ResetMemo();
+	}
+	if (!memo.set(key, source)) {
+		memoCount++;
+	}
+}
+
+void ResourceManager::ForgetMemo(const ResourceMemoKey &key) const
+{
+	std::lock_guard<std::mutex> l(memoLock);
+	if (memo.remove(key)) {
+		memoCount--;
+	}
+}
+
+void ResourceManager::ResetMemo() const
+{
+	memo.init(4096, 256);
+	memoCount = 0;
+}
+
 static void PrintPossibleFiles(StringBuffer& buffer, const char* ResRef, const TypeID *type)
 {
 	const std::vector<ResourceDesc>& types = PluginMgr::Get()->GetResourceDesc(type);
@@ -71,12 +197,16 @@ bool ResourceManager::Exists(const char *ResRef, SClass_ID type, bool silent) co
 {
 	if (ResRef[0] == '\0')
 		return false;
-	// TODO: check various caches
+	MemoLookup lookup(this, ResRef, type, NULL);
 	for (size_t i = 0; i < searchPath.size(); i++) {
+		if (lookup.Skip(i)) continue;
 		if (searchPath[i]->HasResource( ResRef, type )) {
+			lookup.Found(i);
 			return true;
 		}
+		lookup.NotFound(i);
 	}
+	lookup.Missing();
 	if (!silent) {
 		Log(WARNING, "ResourceManager", "'%s.%s' not found...",
 			ResRef, core->TypeExt(type));
@@ -88,14 +218,18 @@ bool ResourceManager::Exists(const char *ResRef, const TypeID *type, bool silent
 {
 	if (ResRef[0] == '\0')
 		return false;
-	// TODO: check various caches
 	const std::vector<ResourceDesc> &types = PluginMgr::Get()->GetResourceDesc(type);
 	for (size_t j = 0; j < types.size(); j++) {
+		MemoLookup lookup(this, ResRef, types[j].GetKeyType(), types[j].GetExt());
 		for (size_t i = 0; i < searchPath.size(); i++) {
+			if (lookup.Skip(i)) continue;
 			if (searchPath[i]->HasResource(ResRef, types[j])) {
+				lookup.Found(i);
 				return true;
 			}
+			lookup.NotFound(i);
 		}
+		lookup.Missing();
 	}
 	if (!silent) {
 		StringBuffer buffer;
@@ -111,16 +245,22 @@ DataStream* ResourceManager::GetResource(const char* ResRef, SClass_ID type, boo
 {
 	if (ResRef[0] == '\0')
 		return NULL;
+	MemoLookup lookup(this, ResRef, type, NULL);
 	for (size_t i = 0; i < searchPath.size(); i++) {
+		if (lookup.Skip(i)) continue;
 		DataStream *ds = searchPath[i]->GetResource(ResRef, type);
-		if (ds) {
-			if (!silent) {
-				Log(MESSAGE, "ResourceManager", "Found '%s.%s' in '%s'.",
-					ResRef, core->TypeExt(type), searchPath[i]->GetDescription());
-			}
-			return ds;
+		if (!ds) {
+			lookup.NotFound(i);
+			continue;
+		}
+		lookup.Found(i);
+		if (!silent) {
+			Log(MESSAGE, "ResourceManager", "Found '%s.%s' in '%s'.",
+				ResRef, core->TypeExt(type), searchPath[i]->GetDescription());
 		}
+		return ds;
 	}
+	lookup.Missing();
 	if (!silent) {
 		Log(ERROR, "ResourceManager", "Couldn't find '%s.%s'.",
 			ResRef, core->TypeExt(type));
@@ -137,15 +277,22 @@ Resource* ResourceManager::GetResource(const char* ResRef, const TypeID *type, b
 	}
 	const std::vector<ResourceDesc> &types = PluginMgr::Get()->GetResourceDesc(type);
 	for (size_t j = 0; j < types.size(); j++) {
+		MemoLookup lookup(this, ResRef, types[j].GetKeyType(), types[j].GetExt());
 		for (size_t i = 0; i < searchPath.size(); i++) {
-			DataStream *str = searchPath[i]->GetResource(ResRef, types[j]);
+			DataStream *str = NULL;
+			if (!lookup.Skip(i)) {
+				str = searchPath[i]->GetResource(ResRef, types[j]);
+			}
 			if (!str && useCorrupt && core->UseCorruptedHack) {
 				// don't look at other paths if requested
 				core->UseCorruptedHack = false;
 				return NULL;
 			}
 			core->UseCorruptedHack = false;
-			if (str) {
+			if (!str) {
+				lookup.NotFound(i);
+			} else {
+				lookup.Found(i);
 				Resource *res = types[j].Create(str);
 				if (res) {
 					if (!silent) {
@@ -154,8 +301,11 @@ Resource* ResourceManager::GetResource(const char* ResRef, const TypeID *type, b
 					}
 					return res;
 				}
+				// later copies could still be usable
+				lookup.Abandon();
 			}
 		}
+		lookup.Missing();
 	}
 	if (!silent) {
 		StringBuffer buffer;
@@ -23,9 +23,12 @@
 
 #include "SClassID.h"
 #include "exports.h"
+#include "globals.h"
 
+#include "HashMap.h"
 #include "Holder.h"
 
+#include <mutex>
 #include <vector>
 
 #if defined(_MSC_VER) || defined(__sgi) // No SFINAE
@@ -43,6 +46,44 @@ class ResourceSource;
 #endif
 class TypeID;
 
+// key for the lookup memo: a resref with either a plain type or a resource descriptor
+struct ResourceMemoKey {
+	ieResRef ref;
+	SClass_ID type;
+	const char *ext; // NULL for plain types
+
+	ResourceMemoKey() : type(0), ext(NULL)
+	{
+		ref[0] = 0;
+	}
+};
+
+template<>
+struct HashKey<ResourceMemoKey> {
+	static inline unsigned int hash(const ResourceMemoKey &key)
+	{
+		unsigned int h = key.type;
+		const char *c = key.ref;
+
+		for (unsigned int i = 0; *c && i < sizeof(ieResRef); ++i)
+			h = (h << 5) + h + tolower(*c++);
+
+		return h;
+	}
+
+	static inline bool equals(const ResourceMemoKey &a, const ResourceMemoKey &b)
+	{
+		return a.type == b.type && a.ext == b.ext && stricmp(a.ref, b.ref) == 0;
+	}
+
+	static inline void copy(ResourceMemoKey &a, const ResourceMemoKey &b)
+	{
+		a.type = b.type;
+		a.ext = b.ext;
+		strncpy(a.ref, b.ref, sizeof(ieResRef));
+	}
+};
+
 class GEM_EXPORT ResourceManager {
 public:
 	ResourceManager();
@@ -67,8 +108,27 @@ public:
 	/** Returns Resource object associated to given resource */
 	Resource* GetResource(const char* resname, const TypeID *type, bool silent = false, bool useCorrupt = false) const;
 
+	/** Returns how many lookups were answered by the memo */
+	void GetMemoStats(unsigned int &hits, unsigned int &misses) const;
+
 private:
 	std::vector<Holder<ResourceSource> > searchPath;
+
+	// remembers which non-volatile source holds a resource (or that none does);
+	// volatile sources are always probed directly
+	mutable HashMap<ResourceMemoKey, size_t> memo;
+	mutable unsigned int memoCount;
+	mutable unsigned int memoRevision;
+	mutable unsigned int memoHits, memoMisses;
+	mutable std::mutex memoLock;
+
+	struct MemoLookup;
+
+	/** Fetches the memoized source index for key, returns false if it isn't known yet */
+	bool LookupMemo(const ResourceMemoKey &key, size_t &source) const;
+	void SetMemo(const ResourceMemoKey &key, size_t source) const;
+	void ForgetMemo(const ResourceMemoKey &key) const;
+	void ResetMemo() const;
 };
 
 }
@@ -25,6 +25,7 @@ namespace GemRB {
 ResourceSource::ResourceSource(void)
 {
 	description = NULL;
+	revision = 0;
 }
 
 ResourceSource::~ResourceSource(void)
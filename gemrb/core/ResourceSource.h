@@ -42,8 +42,13 @@ public:
 	virtual DataStream* GetResource(const char* resname, SClass_ID type) = 0;
 	virtual DataStream* GetResource(const char* resname, const ResourceDesc &type) = 0;
 	const char *GetDescription() const { return description; }
+	/** Returns true if the contents may change while the source is open */
+	virtual bool IsVolatile() const { return false; }
+	/** Changes every time the source reloads its contents */
+	unsigned int GetRevision() const { return revision; }
 protected:
 	char *description;
+	unsigned int revision;
 };
 
 }
@@ -521,6 +521,8 @@ Actor::Actor()
 	SetDeathVar = IncKillCount = UnknownField = 0;
 	memset( DeathCounters, 0, sizeof(DeathCounters) );
 	InParty = 0;
+	gridCell = -1;
+	gridOrder = 0;
 	TalkCount = 0;
 	InteractCount = 0; //numtimesinteracted depends on this
 	appearance = 0xffffff; //might be important for created creatures
@@ -8242,20 +8244,41 @@ void Actor::SetRunFlags(ieDword flags)
 void Actor::NewPath()
 {
 	if (Destination == Pos) return;
-	// WalkTo's and FindPath's first argument is passed by reference
-	// And we don't want to modify Destination so we use a temporary
-	Point tmp = Destination;
 	if (GetPathTries() > MAX_PATH_TRIES) {
 		ClearPath(true);
 		ResetPathTries();
 		return;
 	}
-	WalkTo(tmp, InternalFlags, pathfindingDistance);
+	// the actor keeps its current step (if any) until the search is done
+	area->RequestPath(this);
+}
+
+// WalkTo up to the search, for the destination at the time the queued
+// request is resolved; false if no search is needed anymore
+bool Actor::BeginNewPath()
+{
+	if (Destination == Pos) return false;
+	ResetPathTries();
+	if (!(InternalFlags & IF_REALLYDIED) && walkScale != 0) {
+		SetRunFlags(InternalFlags);
+		ResetCommentTime();
+		if (PrepareWalkTo(Destination)) {
+			return true;
+		}
+	}
 	if (!GetPath()) {
 		IncrementPathTries();
 	}
+	return false;
 }
 
+void Actor::FinishNewPath(Path *newPath)
+{
+	FinishWalkTo(newPath, pathfindingDistance);
+	if (!GetPath()) {
+		IncrementPathTries();
+	}
+}
 
 void Actor::WalkTo(const Point &Des, ieDword flags, int MinDistance)
 {
@@ -312,6 +312,9 @@ public:
 	ieResRef LargePortrait;
 	/** 0: NPC, 1-8 party slot */
 	ieByte InParty;
+	/** bucket and list position in the area's actor grid, see Map::UpdateActorGrid */
+	int gridCell;
+	ieDword gridOrder;
 	char* LongName, * ShortName;
 	ieStrRef ShortStrRef, LongStrRef;
 	ieStrRef StrRefs[VCONST_COUNT];
@@ -728,6 +731,9 @@ public:
 		int phase = -1) const;
 	bool Schedule(ieDword gametime, bool checkhide) const;
 	void NewPath();
+	/* the rest of NewPath when its queued search is due, see Map::RequestPath */
+	bool BeginNewPath();
+	void FinishNewPath(Path *newPath);
 	/* overridden method, won't walk if dead */
 	void WalkTo(const Point &Des, ieDword flags, int MinDistance = 0);
 	/* resolve string constant (sound will be altered) */
@@ -610,7 +610,8 @@ bool Scriptable::InMove() const
 		return false;
 	}
 	Movable *me = (Movable *) this;
-	return me->GetStep() != NULL;
+	// waiting for a queued search counts too, so actions don't give up on the walk
+	return me->GetStep() != NULL || me->IsPathPending();
 }
 
 void Scriptable::SetWait(unsigned long time)
@@ -2024,6 +2025,8 @@ Movable::Movable(ScriptableType type)
 	pathfindingDistance = size;
 	randomWalkCounter = 0;
 	pathAbandoned = false;
+	pathPending = false;
+	pathFailed = false;
 }
 
 Movable::~Movable(void)
@@ -2033,6 +2036,11 @@ Movable::~Movable(void)
 	}
 }
 
+PathNode *Movable::GetPath() const
+{
+	return path ? path->Front() : nullptr;
+}
+
 int Movable::GetPathLength() const
 {
 	const PathNode *node = GetNextStep(0);
@@ -2239,14 +2247,14 @@ void Movable::DoStep(unsigned int walkScale, ieDword time) {
 		return;
 	}
 	if (!time) time = core->GetGame()->Ticks;
-	if (!walkScale) {
-		// zero speed: no movement
+	if (!walkScale || pathPending) {
+		// zero speed or waiting for a new path: no movement
 		StanceID = IE_ANI_READY;
 		timeStartStep = time;
 		return;
 	}
 	if (!step) {
-		step = path;
+		step = path->Front();
 		timeStartStep = time;
 		return;
 	}
@@ -2301,6 +2309,9 @@ void Movable::DoStep(unsigned int walkScale, ieDword time) {
 		Pos.x += dx;
 		Pos.y += dy;
 		oldPos = Pos;
+		if (actor) {
+			area->UpdateActorGrid(actor);
+		}
 		if (actor && BlocksSearchMap()) {
 			area->BlockSearchMap(Pos, size, actor->IsPartyMember() ? PATH_MAP_PC : PATH_MAP_NPC);
 		}
@@ -2322,6 +2333,9 @@ void Movable::DoStep(unsigned int walkScale, ieDword time) {
 void Movable::AdjustPosition()
 {
 	area->AdjustPosition(Pos);
+	if (Type == ST_ACTOR) {
+		area->UpdateActorGrid((Actor *) this);
+	}
 	ImpedeBumping();
 }
 
@@ -2332,56 +2346,80 @@ void Movable::AddWayPoint(const Point &Des)
 		return;
 	}
 	Destination = Des;
-	//it is tempting to use 'step' here, as it could
-	//be about half of the current path already
-	PathNode *endNode = path;
-	while(endNode->Next) {
-		endNode = endNode->Next;
-	}
+	const PathNode *endNode = path->Back();
 	Point p(endNode->x, endNode->y);
 	area->ClearSearchMapFor(this);
-	PathNode *path2 = area->FindPath(p, Des, size);
-	endNode->Next = path2;
-	//probably it is wise to connect it both ways?
-	path2->Parent = endNode;
+	Path *path2 = area->FindPath(p, Des, size);
+	if (!path2) {
+		return;
+	}
+	// appending may move the nodes, so keep our place by index
+	size_t current = step ? path->IndexOf(step) : 0;
+	path->Append(*path2);
+	delete path2;
+	if (step) {
+		step = &(*path)[current];
+	}
 }
 
 // This function is called at each tick if an actor is following another actor
 // Therefore it's rate-limited to avoid actors being stuck as they keep pathfinding
+// Actors get their path on the next update, from the path workers (see
+// Map::RequestPath), and stand still meanwhile. The callers check InMove()
+// right after this to give up on unreachable places, so a search that failed
+// during this update isn't requested again for the same place.
 void Movable::WalkTo(const Point &Des, int distance)
 {
-	// Only rate-limit when moving
-	if ((GetPath() || InMove()) && prevTicks && Ticks < prevTicks + 2) {
+	if (pathFailed && Des == Destination) {
+		return;
+	}
+	if (!PrepareWalkTo(Des)) {
 		return;
 	}
 
-	Actor *actor = nullptr;
-	if (Type == ST_ACTOR) actor = (Actor*)this;
+	if (Type == ST_ACTOR) {
+		pathfindingDistance = distance;
+		pathPending = true;
+		area->RequestPath((Actor *) this);
+		return;
+	}
+
+	if (BlocksSearchMap()) area->ClearSearchMapFor(this);
+	Path *newPath = area->FindPath(Pos, Des, size, distance, PF_SIGHT|PF_ACTORS_ARE_BLOCKING, nullptr);
+	FinishWalkTo(newPath, distance);
+}
+
+// returns false if no search is needed (or allowed) for walking to Des
+bool Movable::PrepareWalkTo(const Point &Des)
+{
+	// Only rate-limit when moving
+	if ((GetPath() || InMove()) && prevTicks && Ticks < prevTicks + 2) {
+		return false;
+	}
 
 	prevTicks = Ticks;
 	Destination = Des;
 	if (pathAbandoned) {
 		Log(DEBUG, "WalkTo", "%s: Path was just abandoned", GetName(0));
 		ClearPath(true);
-		return;
+		return false;
 	}
 
 	if (Pos.x / 16 == Des.x / 16 && Pos.y / 12 == Des.y / 12) {
 		ClearPath(true);
-		return;
-	}
-
-	if (BlocksSearchMap()) area->ClearSearchMapFor(this);
-	PathNode *newPath = area->FindPath(Pos, Des, size, distance, PF_SIGHT|PF_ACTORS_ARE_BLOCKING, actor);
-	if (!newPath && actor && actor->ValidTarget(GA_CAN_BUMP)) {
-		Log(DEBUG, "WalkTo", "%s re-pathing ignoring actors", GetName(0));
-		newPath = area->FindPath(Pos, Des, size, distance, PF_SIGHT, actor);
+		return false;
 	}
+	return true;
+}
 
+void Movable::FinishWalkTo(Path *newPath, int distance)
+{
+	pathPending = false;
+	pathFailed = !newPath;
 	if (newPath) {
 		ClearPath(false);
 		path = newPath;
-		step = path;
+		step = path->Front();
 	}  else {
 		pathfindingDistance = std::max(size, distance);
 		if (BlocksSearchMap()) {
@@ -2459,7 +2497,7 @@ void Movable::RandomWalk(bool can_stop, bool run)
 		area->BlockSearchMap(Pos, size, IsPC() ? PATH_MAP_PC : PATH_MAP_NPC);
 	}
 	if (path) {
-		Destination = Point(path->x, path->y);
+		Destination = Point(path->Front()->x, path->Front()->y);
 	} else {
 		randomWalkCounter = 0;
 		WalkTo(HomeLocation);
@@ -2474,6 +2512,9 @@ void Movable::MoveTo(const Point &Des)
 	Pos = Des;
 	oldPos = Des;
 	Destination = Des;
+	if (Type == ST_ACTOR) {
+		area->UpdateActorGrid((Actor *) this);
+	}
 	if (BlocksSearchMap()) {
 		area->BlockSearchMap( Pos, size, IsPC()?PATH_MAP_PC:PATH_MAP_NPC);
 	}
@@ -2488,6 +2529,7 @@ void Movable::Stop()
 void Movable::ClearPath(bool resetDestination)
 {
 	pathAbandoned = false;
+	pathPending = false;
 
 	if (resetDestination) {
 		//this is to make sure attackers come to us
@@ -2500,12 +2542,7 @@ void Movable::ClearPath(bool resetDestination)
 		}
 		InternalFlags &= ~IF_NORETICLE;
 	}
-	PathNode* thisNode = path;
-	while (thisNode) {
-		PathNode* nextNode = thisNode->Next;
-		delete( thisNode );
-		thisNode = nextNode;
-	}
+	delete path;
 	path = NULL;
 	step = NULL;
 	//don't call ReleaseCurrentAction
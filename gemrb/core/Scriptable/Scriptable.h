@@ -42,6 +42,7 @@ class InfoPoint;
 class Map;
 class Movable;
 class Object;
+class Path;
 struct PathNode;
 class Scriptable;
 class Selectable;
@@ -480,11 +481,15 @@ private: //these seem to be sensitive, so get protection
 	unsigned char Orientation, NewOrientation;
 	ieWord AttackMovements[3];
 
-	PathNode* path; //whole path
+	Path* path; //whole path
 	PathNode* step; //actual step
 	unsigned int prevTicks;
 	int bumpBackTries;
 	bool pathAbandoned;
+	// a queued search for a new path is running, see Map::RequestPath
+	bool pathPending;
+	// the queued search of a WalkTo failed during this update
+	bool pathFailed;
 protected:
 	ieDword timeStartStep;
 	//the # of previous tries to pick up a new walkpath
@@ -518,10 +523,15 @@ public:
 	void BumpBack();
 	inline bool IsBumped() const { return bumped; }
 	PathNode *GetNextStep(int x) const;
-	inline PathNode *GetPath() const { return path; };
+	PathNode *GetPath() const;
 	inline int GetPathTries() const	{ return pathTries; }
+	inline int GetPathfindingDistance() const { return pathfindingDistance; }
 	inline void IncrementPathTries() { pathTries++; }
 	inline void ResetPathTries() { pathTries = 0; }
+	/* the actor stands still on its path until the queued search is done */
+	inline void SetPathPending(bool pending) { pathPending = pending; }
+	inline bool IsPathPending() const { return pathPending; }
+	inline void ClearPathFailed() { pathFailed = false; }
 	int GetPathLength() const;
 //inliners to protect data consistency
 	inline PathNode * GetStep() {
@@ -555,6 +565,9 @@ public:
 	int GetRandomWalkCounter() const { return randomWalkCounter; };
 	void MoveLine(int steps, ieDword Orient);
 	void WalkTo(const Point &Des, int MinDistance = 0);
+	/* the parts of WalkTo before and after the search, for queued paths */
+	bool PrepareWalkTo(const Point &Des);
+	void FinishWalkTo(Path *newPath, int MinDistance);
 	void MoveTo(const Point &Des);
 	void Stop();
 	void ClearPath(bool resetDestination = true);
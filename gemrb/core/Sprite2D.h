@@ -42,6 +42,19 @@ namespace GemRB {
 
 class AnimationFactory;
 
+// pixels between the checkpoints in each row of an RLE sprite
+#define RLE_CHECKPOINT_STEP 64
+
+/**
+ * A place in the RLE data of a sprite where decoding can start. The run
+ * found at offset starts on the given pixel, relative to the checkpoint
+ * (so it is never positive, the run may have started in an earlier row).
+ */
+struct RLECheckpoint {
+	ieDword offset;
+	ieWordSigned start;
+};
+
 /**
  * @class Sprite2D
  * Class representing bitmap data.
@@ -77,6 +90,8 @@ public:
 	virtual ieDword GetColorKey() const = 0;
 	/* SetColorKey: ieDword is either a px value or a palete index if sprite has a palette. */
 	virtual void SetColorKey(ieDword) = 0;
+	/* GetRLECheckpoints: for RLE sprites, the checkpoints of each row, one every RLE_CHECKPOINT_STEP pixels; NULL if there are none. */
+	virtual const RLECheckpoint* GetRLECheckpoints() const { return NULL; }
 	virtual bool ConvertFormatTo(int /*bpp*/, ieDword /*rmask*/, ieDword /*gmask*/,
 							   ieDword /*bmask*/, ieDword /*amask*/) { return false; }; // not pure virtual!
 	void acquire() { ++RefCount; }
@@ -27,7 +27,6 @@ namespace GemRB {
 
 SpriteCover::SpriteCover()
 {
-	pixels = 0;
 	worldx = worldy = XPos = YPos = Width = Height = flags = 0;
 }
 
@@ -23,11 +23,28 @@
 
 #include "exports.h"
 
+#include <memory>
+#include <vector>
+
 namespace GemRB {
 
+// a run of covered pixels on a row of the cover
+struct CoverSpan {
+	int x0, x1; // the covered columns, x0 <= x < x1
+	bool dither; // only every other pixel is covered, see SpriteCover::DitherCovers
+};
+
+// The covered pixels, row by row. The spans of a row are sorted, don't
+// overlap and a full span wins over a dithered one.
+// Shared by all the covers built for the same place and box.
+struct CoverSpans {
+	std::vector<CoverSpan> spans;
+	std::vector<int> rows; // the spans of row y are rows[y] up to rows[y+1]
+};
+
 class GEM_EXPORT SpriteCover {
 public:
-	unsigned char* pixels;
+	std::shared_ptr<CoverSpans> spans;
 	int worldx, worldy; // world coords for which the cover has been computed
 	int XPos, YPos, Width, Height;
 	int flags;
@@ -35,6 +52,13 @@ public:
 	~SpriteCover(void);
 
 	bool Covers(int x, int y, int xpos, int ypos, int width, int height) const;
+
+	const CoverSpan* RowBegin(int y) const { return spans->spans.data() + spans->rows[y]; }
+	const CoverSpan* RowEnd(int y) const { return spans->spans.data() + spans->rows[y+1]; }
+	// the parity of the dither pattern, it follows the world coordinates
+	int DitherParity() const { return (worldx - XPos + worldy - YPos) & 1; }
+	// whether a dithered span covers column x of row y
+	static bool DitherCovers(int x, int y, int parity) { return !((x + y + parity) & 1); }
 };
 
 
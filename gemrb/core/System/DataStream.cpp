@@ -222,6 +222,37 @@ int DataStream::ReadLine(void* buf, unsigned int maxlen)
 	return i;
 }
 
+const char* DataStream::ReadSpan(unsigned int len, std::vector<char>& storage)
+{
+	const char* span = GetSpan(len);
+	if (span) {
+		return span;
+	}
+
+	storage.resize(len);
+	if (len && Read(storage.data(), len) == GEM_ERROR) {
+		return NULL;
+	}
+	return storage.data();
+}
+
+const char* DataStream::GetSpan(unsigned int /*len*/)
+{
+	return NULL;
+}
+
+ieWord DataStream::WordAt(const char* src)
+{
+	const unsigned char* p = (const unsigned char*) src;
+	return ieWord(p[0] | (p[1] << 8));
+}
+
+ieDword DataStream::DwordAt(const char* src)
+{
+	const unsigned char* p = (const unsigned char*) src;
+	return ieDword(p[0]) | (ieDword(p[1]) << 8) | (ieDword(p[2]) << 16) | (ieDword(p[3]) << 24);
+}
+
 DataStream* DataStream::Clone()
 {
 	return NULL;
@@ -30,6 +30,8 @@
 
 #include "Platform.h"
 
+#include <vector>
+
 namespace GemRB {
 
 #define GEM_CURRENT_POS 0
@@ -70,6 +72,13 @@ public:
 	bool CheckEncrypted();
 	void ReadDecrypted(void* buf, unsigned int size);
 	int ReadLine(void* buf, unsigned int maxlen);
+	/** Returns the next len bytes as one contiguous block and skips past them.
+	 *  Memory backed streams hand out a pointer into their own buffer, others
+	 *  read into storage. Returns NULL on error. */
+	const char* ReadSpan(unsigned int len, std::vector<char>& storage);
+	/** Decode little endian fields from a span */
+	static ieWord WordAt(const char* src);
+	static ieDword DwordAt(const char* src);
 	/** Endian Switch setup */
 	static void SetEndianSwitch(int par);
 	static bool IsEndianSwitch();
@@ -78,6 +87,9 @@ public:
 	 *  Returns NULL on failure.
 	 **/
 	virtual DataStream* Clone();
+protected:
+	/** Direct view of the next len bytes, or NULL if the stream can't provide one */
+	virtual const char* GetSpan(unsigned int len);
 private:
 	DataStream(const DataStream&);
 };
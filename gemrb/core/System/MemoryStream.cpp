@@ -62,6 +62,18 @@ int MemoryStream::Read(void* dest, unsigned int length)
 	return length;
 }
 
+const char* MemoryStream::GetSpan(unsigned int length)
+{
+	// encrypted data needs to be copied out anyway
+	if (Encrypted || !data || Pos + length > size) {
+		return NULL;
+	}
+
+	const char* span = data + Pos;
+	Pos += length;
+	return span;
+}
+
 int MemoryStream::Write(const void* src, unsigned int length)
 {
 	if (Pos+length>size ) {
@@ -39,6 +39,8 @@ public:
 	int Read(void* dest, unsigned int length) override;
 	int Write(const void* src, unsigned int length) override;
 	int Seek(int pos, int startpos) override;
+protected:
+	const char* GetSpan(unsigned int len) override;
 };
 
 }
@@ -20,11 +20,13 @@
 
 #include "TileOverlay.h"
 
-//#include "Game.h" // needed only for TILE_GREY below
+#include "Game.h" // for the global tint
 #include "GlobalTimer.h"
 #include "Interface.h"
 #include "Video.h"
 
+#include <algorithm>
+
 namespace GemRB {
 
 bool RedrawTile = false;
@@ -35,6 +37,10 @@ TileOverlay::TileOverlay(int Width, int Height)
 	h = Height;
 	count = 0;
 	tiles = ( Tile * * ) malloc( w * h * sizeof( Tile * ) );
+	cacheColumns = cacheRows = 0;
+	cacheFlags = 0;
+	cacheTint = Color();
+	cacheTinted = false;
 }
 
 TileOverlay::~TileOverlay(void)
@@ -79,6 +85,72 @@ void TileOverlay::BumpViewport(const Region &viewport, Region &vp)
 	}
 }
 
+// Opens the video driver's tile cache and forgets the cells that can't be
+// reused this time. Returns false if there is no cache.
+bool TileOverlay::ValidateTileCache(Video* vid, int columns, int rows, int flags)
+{
+	bool lost = false;
+	if (!vid->OpenTileCache(this, columns, rows, lost)) {
+		return false;
+	}
+
+	// the tint is applied when blitting, so it is part of every cell
+	const Color* tint = NULL;
+	const Game* game = core->GetGame();
+	if (game) {
+		tint = game->GetGlobalTint();
+	}
+	bool retint = (tint != NULL) != cacheTinted;
+	if (tint && !retint) {
+		retint = tint->r != cacheTint.r || tint->g != cacheTint.g || tint->b != cacheTint.b || tint->a != cacheTint.a;
+	}
+
+	if (lost || retint || columns != cacheColumns || rows != cacheRows || flags != cacheFlags) {
+		TileCacheCell empty = { -1, NULL };
+		cacheCells.assign(columns * rows, empty);
+		cacheColumns = columns;
+		cacheRows = rows;
+		cacheFlags = flags;
+		cacheTinted = tint != NULL;
+		if (tint) {
+			cacheTint = *tint;
+		}
+	}
+	return true;
+}
+
+// copies the visible tiles sx,sy to dx,dy from the tile cache to the screen,
+// in at most four blocks, split where the cells wrap around
+void TileOverlay::DrawTileCache(Video* vid, int columns, int rows, int sx, int sy, int dx, int dy, const Region &viewport)
+{
+	for (int y = sy; y < dy; ) {
+		int y2 = std::min(dy, (y / rows + 1) * rows);
+		for (int x = sx; x < dx; ) {
+			int x2 = std::min(dx, (x / columns + 1) * columns);
+			Region cells(x % columns, y % rows, x2 - x, y2 - y);
+			vid->DrawTileCells(cells, viewport.x + x * 64, viewport.y + y * 64, &viewport);
+			x = x2;
+		}
+		y = y2;
+	}
+}
+
+//draw overlay tiles, they should be half transparent
+void TileOverlay::DrawOverlays(Video* vid, const Tile* tile, const Sprite2D* mask,
+	const std::vector<const Sprite2D*> &overlayFrames, int x, int y, const Region &viewport, int flags)
+{
+	if (!RedrawTile) {
+		flags |= TILE_HALFTRANS;
+	}
+	int bit = 2;
+	for (size_t z = 1; z < overlayFrames.size(); z++) {
+		if (overlayFrames[z] && (tile->om & bit)) {
+			vid->BlitTile(overlayFrames[z], mask, x, y, &viewport, flags);
+		}
+		bit <<= 1;
+	}
+}
+
 void TileOverlay::Draw(Region viewport, std::vector< TileOverlay*> &overlays, int flags)
 {
 	Video* vid = core->GetVideoDriver();
@@ -89,11 +161,37 @@ void TileOverlay::Draw(Region viewport, std::vector< TileOverlay*> &overlays, in
 	// determine which tiles are visible
 	int sx = vp.x / 64;
 	int sy = vp.y / 64;
-	int dx = ( vp.x + vp.w + 63 ) / 64;
-	int dy = ( vp.y + vp.h + 63 ) / 64;
+	int dx = std::min(( vp.x + vp.w + 63 ) / 64, w);
+	int dy = std::min(( vp.y + vp.h + 63 ) / 64, h);
 
-	for (int y = sy; y < dy && y < h; y++) {
-		for (int x = sx; x < dx && x < w; x++) {
+	// the overlays are all 1x1 tiles, animating the same for every tile they cover
+	std::vector<const Sprite2D*> overlayFrames(overlays.size(), NULL);
+	for (size_t z = 1; z < overlays.size(); z++) {
+		const TileOverlay* ov = overlays[z];
+		if (ov && ov->count > 0) {
+			overlayFrames[z] = ov->tiles[0]->anim[0]->NextFrame();
+		}
+	}
+
+	// The base layer is kept composited in the video driver's off-screen
+	// tile cache, and copied to the screen in one go. The cache has room
+	// for all the visible tiles: tile x,y goes into cell x%columns, y%rows,
+	// so only the newly exposed strips after a scroll and the tiles whose
+	// frame changed (animations, doors) are blitted into it. The overlays
+	// animate all the time, so they are blended in on top afterwards.
+	int columns = vp.w / 64 + 2;
+	int rows = vp.h / 64 + 2;
+	bool cached = core->TileCache && ValidateTileCache(vid, columns, rows, flags);
+
+	struct Overlaid {
+		const Tile* tile;
+		const Sprite2D* mask;
+		int x, y;
+	};
+	std::vector<Overlaid> overlaid;
+
+	for (int y = sy; y < dy; y++) {
+		for (int x = sx; x < dx; x++) {
 			Tile* tile = tiles[( y* w ) + x];
 
 			//draw door tiles if there are any
@@ -102,41 +200,49 @@ void TileOverlay::Draw(Region viewport, std::vector< TileOverlay*> &overlays, in
 				anim = tile->anim[0];
 			}
 			assert(anim);
-			vid->BlitTile( anim->NextFrame(), 0, viewport.x + ( x * 64 ),
-				viewport.y + ( y * 64 ), &viewport, flags );
+			const Sprite2D* frame = anim->NextFrame();
+
+			int tx = viewport.x + x * 64;
+			int ty = viewport.y + y * 64;
+			if (!cached) {
+				vid->BlitTile(frame, 0, tx, ty, &viewport, flags);
+			} else {
+				int column = x % columns;
+				int row = y % rows;
+				TileCacheCell &cell = cacheCells[row * columns + column];
+				if (cell.tile != y * w + x || cell.frame != frame) {
+					vid->BlitTileCell(frame, 0, column, row, flags);
+					cell.tile = y * w + x;
+					cell.frame = frame;
+				}
+			}
+
 			if (!tile->om || tile->tileIndex) {
 				continue;
 			}
-
-			//draw overlay tiles, they should be half transparent
-			int mask = 2;
-			for (size_t z = 1;z<overlays.size();z++) {
-				TileOverlay * ov = overlays[z];
-				if (ov && ov->count > 0) {
-					Tile *ovtile = ov->tiles[0]; //allow only 1x1 tiles now
-					if (tile->om & mask) {
-						if (RedrawTile) {
-							vid->BlitTile( ovtile->anim[0]->NextFrame(),
-						                   tile->anim[0]->NextFrame(),
-							               viewport.x + ( x * 64 ),
-							               viewport.y + ( y * 64 ),
-							               &viewport, flags );
-						} else {
-							Sprite2D* mask = 0;
-							if (tile->anim[1])
-								mask = tile->anim[1]->NextFrame();
-							vid->BlitTile( ovtile->anim[0]->NextFrame(),
-						                   mask,
-							               viewport.x + ( x * 64 ),
-							               viewport.y + ( y * 64 ),
-							               &viewport, TILE_HALFTRANS | flags );
-						}
-					}
-				}
-				mask<<=1;
+			const Sprite2D* mask = NULL;
+			if (RedrawTile) {
+				mask = frame;
+			} else if (tile->anim[1]) {
+				mask = tile->anim[1]->NextFrame();
+			}
+			if (!cached) {
+				DrawOverlays(vid, tile, mask, overlayFrames, tx, ty, viewport, flags);
+			} else {
+				Overlaid o = { tile, mask, tx, ty };
+				overlaid.push_back(o);
 			}
 		}
 	}
+
+	if (!cached) {
+		return;
+	}
+	DrawTileCache(vid, columns, rows, sx, sy, dx, dy, viewport);
+	for (size_t i = 0; i < overlaid.size(); i++) {
+		const Overlaid &o = overlaid[i];
+		DrawOverlays(vid, o.tile, o.mask, overlayFrames, o.x, o.y, viewport, flags);
+	}
 }
 
 }
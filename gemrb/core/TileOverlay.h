@@ -31,12 +31,32 @@ namespace GemRB {
 
 extern bool RedrawTile;
 
+class Video;
+
+// what a cell of the video driver's tile cache was last drawn with
+struct TileCacheCell {
+	int tile; // -1 if the cell holds nothing of ours
+	const Sprite2D* frame;
+};
+
 class GEM_EXPORT TileOverlay {
 public:
 	int w, h;
 	//std::vector<Tile*> tiles;
 	Tile** tiles;
 	int count;
+private:
+	// the tile cache, see Draw
+	int cacheColumns, cacheRows;
+	std::vector<TileCacheCell> cacheCells;
+	int cacheFlags;
+	Color cacheTint;
+	bool cacheTinted;
+
+	bool ValidateTileCache(Video* vid, int columns, int rows, int flags);
+	void DrawTileCache(Video* vid, int columns, int rows, int sx, int sy, int dx, int dy, const Region &viewport);
+	void DrawOverlays(Video* vid, const Tile* tile, const Sprite2D* mask,
+		const std::vector<const Sprite2D*> &overlayFrames, int x, int y, const Region &viewport, int flags);
 public:
 	TileOverlay(int Width, int Height);
 	~TileOverlay(void);
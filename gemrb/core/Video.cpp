@@ -24,6 +24,7 @@
 #include "Palette.h"
 #include "Sprite2D.h"
 
+#include <algorithm>
 #include <cmath>
 
 namespace GemRB {
@@ -54,6 +55,7 @@ Video::Video(void)
 	fullscreen = false;
 	subtitlefont = NULL;
 	subtitlepal = NULL;
+	drawnPixels = 0;
 }
 
 Region Video::ClippedDrawingRect(const Region& target, const Region* clip) const
@@ -375,12 +377,106 @@ void Video::MoveViewportTo(int x, int y)
 
 void Video::InitSpriteCover(SpriteCover* sc, int flags)
 {
-	int i;
 	sc->flags = flags;
-	sc->pixels = new unsigned char[sc->Width * sc->Height];
-	for (i = 0; i < sc->Width*sc->Height; ++i)
-		sc->pixels[i] = 0;
-	
+	sc->spans = std::make_shared<CoverSpans>();
+	sc->spans->rows.assign(sc->Height + 1, 0);
+}
+
+// a span and its row, while the rows are merged
+struct RowSpan {
+	int y;
+	CoverSpan span;
+
+	bool operator<(const RowSpan& other) const
+	{
+		if (y != other.y) return y < other.y;
+		return span.x0 < other.span.x0;
+	}
+};
+
+// Walks an edge of a trapezoid row by row. X() is what
+// (b.x * (py - a.y) + a.x * (b.y - py)) / (b.y - a.y) gives for the row,
+// rounded the same way, but without a division per row.
+class EdgeWalker {
+	int q, r, d; // the numerator is q*d + r, with 0 <= r < d
+	int stepq, stepr;
+
+	static int FloorDiv(int n, int div)
+	{
+		int res = n / div;
+		if (res * div > n) res--;
+		return res;
+	}
+
+public:
+	EdgeWalker(const Point& a, const Point& b, int py)
+	{
+		int num = b.x * (py - a.y) + a.x * (b.y - py);
+		int step = b.x - a.x;
+		d = b.y - a.y;
+		if (d < 0) {
+			d = -d;
+			num = -num;
+			step = -step;
+		}
+		q = FloorDiv(num, d);
+		r = num - q * d;
+		stepq = FloorDiv(step, d);
+		stepr = step - stepq * d;
+	}
+
+	int X() const { return (q < 0 && r) ? q + 1 : q; }
+
+	void Next()
+	{
+		q += stepq;
+		r += stepr;
+		if (r >= d) {
+			q++;
+			r -= d;
+		}
+	}
+};
+
+// Appends the union of the spans of a row, where a full span overlaps a
+// dithered one the full one wins
+static void MergeCoverRow(const RowSpan* first, const RowSpan* last,
+	std::vector<CoverSpan>& out, std::vector<int>& bounds)
+{
+	if (last - first == 1) {
+		out.push_back(first->span);
+		return;
+	}
+
+	bounds.clear();
+	for (const RowSpan* s = first; s != last; ++s) {
+		bounds.push_back(s->span.x0);
+		bounds.push_back(s->span.x1);
+	}
+	std::sort(bounds.begin(), bounds.end());
+	bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+	size_t rowstart = out.size();
+	for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+		int x0 = bounds[i];
+		int x1 = bounds[i + 1];
+		// 0: uncovered, 1: dithered, 2: full
+		int state = 0;
+		for (const RowSpan* s = first; s != last && state < 2; ++s) {
+			if (s->span.x0 <= x0 && x1 <= s->span.x1) {
+				state = std::max(state, s->span.dither ? 1 : 2);
+			}
+		}
+		if (!state) continue;
+
+		bool dither = state == 1;
+		if (out.size() > rowstart && out.back().x1 == x0 && out.back().dither == dither) {
+			out.back().x1 = x1;
+		} else {
+			CoverSpan span = { x0, x1, dither };
+			out.push_back(span);
+		}
+	}
 }
 
 // flags: 0 - never dither (full cover)
@@ -388,14 +484,17 @@ void Video::InitSpriteCover(SpriteCover* sc, int flags)
 //	2 - always dither
 void Video::AddPolygonToSpriteCover(SpriteCover* sc, Wall_Polygon* poly)
 {
-	
-	// possible TODO: change the cover to use a set of intervals per line?
-	// advantages: faster
-	// disadvantages: makes the blitter much more complex
-	
 	int xoff = sc->worldx - sc->XPos;
 	int yoff = sc->worldy - sc->YPos;
-	
+
+	bool dither;
+	if (sc->flags == 1) {
+		dither = poly->wall_flag & WF_DITHER;
+	} else {
+		dither = sc->flags != 0;
+	}
+
+	std::vector<RowSpan> added;
 	std::list<Trapezoid>::iterator iter;
 	for (iter = poly->trapezoids.begin(); iter != poly->trapezoids.end();
 		 ++iter)
@@ -413,51 +512,54 @@ void Video::AddPolygonToSpriteCover(SpriteCover* sc, Wall_Polygon* poly)
 		Point& b = poly->points[(ledge+1)%(poly->count)];
 		Point& c = poly->points[redge];
 		Point& d = poly->points[(redge+1)%(poly->count)];
-		
-		unsigned char* line = sc->pixels + (y_top)*sc->Width;
-		for (int sy = y_top; sy < y_bot; ++sy) {
-			int py = sy + yoff;
-			
-			// TODO: maybe use a 'real' line drawing algorithm to
-			// compute these values faster.
-			
-			int lt = (b.x * (py - a.y) + a.x * (b.y - py))/(b.y - a.y);
-			int rt = (d.x * (py - c.y) + c.x * (d.y - py))/(d.y - c.y) + 1;
-			
-			lt -= xoff;
-			rt -= xoff;
+		if (a.y == b.y || c.y == d.y) continue; // no rows to cover
+
+		EdgeWalker left(a, b, y_top + yoff);
+		EdgeWalker right(c, d, y_top + yoff);
+		for (int sy = y_top; sy < y_bot; ++sy, left.Next(), right.Next()) {
+			int lt = left.X() - xoff;
+			int rt = right.X() + 1 - xoff;
 			
 			if (lt < 0) lt = 0;
 			if (rt > sc->Width) rt = sc->Width;
-			if (lt >= rt) { line += sc->Width; continue; } // clipped
-			int dither;
-			
-			if (sc->flags == 1) {
-				dither = poly->wall_flag & WF_DITHER;
-			} else {
-				dither = sc->flags;
-			}
-			if (dither) {
-				unsigned char* pix = line + lt;
-				unsigned char* end = line + rt;
-				
-				if ((lt + xoff + sy + yoff) % 2) pix++; // CHECKME: aliasing?
-				for (; pix < end; pix += 2)
-					*pix = 1;
-			} else {
-				// we hope memset is faster
-				// condition: lt < rt is true
-				memset (line+lt, 1, rt-lt);
-			}
-			line += sc->Width;
+			if (lt >= rt) continue; // clipped
+
+			RowSpan rs = { sy, { lt, rt, dither } };
+			added.push_back(rs);
+		}
+	}
+	if (added.empty()) return;
+
+	// merge the new spans with those of the polygons added before
+	CoverSpans& cs = *sc->spans;
+	for (int y = 0; y < sc->Height; ++y) {
+		for (int i = cs.rows[y]; i < cs.rows[y + 1]; ++i) {
+			RowSpan rs = { y, cs.spans[i] };
+			added.push_back(rs);
+		}
+	}
+	std::sort(added.begin(), added.end());
+
+	std::vector<CoverSpan> merged;
+	merged.reserve(added.size());
+	std::vector<int> bounds;
+	size_t i = 0;
+	for (int y = 0; y < sc->Height; ++y) {
+		cs.rows[y] = (int) merged.size();
+		size_t j = i;
+		while (j < added.size() && added[j].y == y) ++j;
+		if (j != i) {
+			MergeCoverRow(&added[i], &added[0] + j, merged, bounds);
 		}
+		i = j;
 	}
+	cs.rows[sc->Height] = (int) merged.size();
+	cs.spans.swap(merged);
 }
 
 void Video::DestroySpriteCover(SpriteCover* sc)
 {
-	delete[] sc->pixels;
-	sc->pixels = NULL;
+	sc->spans.reset();
 }
 
 void Video::GetMousePos(int &x, int &y)
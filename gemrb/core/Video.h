@@ -108,6 +108,8 @@ protected:
 	Palette *subtitlepal;
 	Region subtitleregion;
 	Color fadeColor;
+	// pixels repainted for the last presented frame, see InvalidateRegion
+	unsigned long drawnPixels;
 protected:
 	Region ClippedDrawingRect(const Region& target, const Region* clip = NULL) const;
 public:
@@ -121,6 +123,13 @@ public:
 	virtual bool SetFullscreenMode(bool set) = 0;
 	/** Swaps displayed and back buffers */
 	virtual int SwapBuffers(void) = 0;
+	/** Marks a screen area as drawn to, so the next SwapBuffers presents it.
+	 * Drivers that present the whole screen every frame can ignore this. */
+	virtual void InvalidateRegion(const Region& /*rgn*/) {}; // not pure virtual!
+	/** Marks the whole screen as drawn to */
+	void InvalidateScreen() { InvalidateRegion(Region(0, 0, width, height)); }
+	/** Returns how many pixels were repainted for the last presented frame */
+	unsigned long GetDrawnPixels() const { return drawnPixels; }
 	/** Grabs and releases mouse cursor within GemRB window */
 	virtual bool ToggleGrabInput() = 0;
 	virtual short GetWidth() = 0;
@@ -144,6 +153,18 @@ public:
 
 	virtual void BlitTile(const Sprite2D* spr, const Sprite2D* mask, int x, int y,
 						  const Region* clip, unsigned int flags) = 0;
+	/** Keeps columns x rows tiles off-screen for owner, so they can be drawn
+	 * again without blitting them. Returns false if the driver can't, sets
+	 * lost if the cells no longer hold what owner last put in them. */
+	virtual bool OpenTileCache(const void* /*owner*/, int /*columns*/, int /*rows*/,
+							   bool& /*lost*/) { return false; }; // not pure virtual!
+	/** Blits a tile into a cell of the tile cache, like BlitTile does */
+	virtual void BlitTileCell(const Sprite2D* /*spr*/, const Sprite2D* /*mask*/,
+							  int /*column*/, int /*row*/, unsigned int /*flags*/) {};
+	/** Draws a block of cells of the tile cache (in cell units) where
+	 * BlitTile would draw the tile of its top left cell */
+	virtual void DrawTileCells(const Region& /*cells*/, int /*x*/, int /*y*/,
+							   const Region* /*clip*/) {};
 	virtual void BlitSprite(const Sprite2D* spr, int x, int y, bool anchor = false,
 							const Region* clip = NULL, Palette* palette = NULL) = 0;
 	virtual void BlitSprite(const Sprite2D* spr, const Region& src, const Region& dst,
@@ -159,9 +159,10 @@ namespace GemRB {
 #define  GF_FIXED_MORALE_OPCODE         78 // bg2
 #define  GF_HAPPINESS                   79 // all except pst and iwd2
 #define  GF_EFFICIENT_OR                80 // does the OR trigger shortcircuit on success or not? Only in iwd2
+#define  GF_SAMPLED_LINES               81 // walk LOS and walkability lines in steps like older gemrb, not cell by cell
 
 //update this or bad things can happen
-#define GF_COUNT 81
+#define GF_COUNT 82
 
 //the number of item usage fields (used in CREItem and STOItem)
 #define CHARGE_COUNTERS  3
@@ -43,6 +43,18 @@ p2DAImporter::~p2DAImporter(void)
 	}
 }
 
+// duplicate names keep the first index, like the old linear search did
+void p2DAImporter::BuildIndex(NameIndex& index, const std::vector< char*>& names)
+{
+	unsigned int count = (unsigned int) names.size();
+	index.init(count > 1024 ? 1024 : count + 1, count + 1);
+	for (unsigned int i = 0; i < count; i++) {
+		if (index.find(names[i]) < 0) {
+			index.set(names[i], i);
+		}
+	}
+}
+
 bool p2DAImporter::Open(DataStream* str)
 {
 	if (str == NULL) {
@@ -106,6 +118,8 @@ bool p2DAImporter::Open(DataStream* str)
 			row++;
 		}
 	}
+	BuildIndex(colIndex, colNames);
+	BuildIndex(rowIndex, rowNames);
 	delete str;
 	return true;
 }
@@ -24,6 +24,7 @@
 #include "TableMgr.h"
 
 #include "globals.h"
+#include "StringMap.h"
 
 #include <cstring>
 #include <vector>
@@ -32,13 +33,36 @@ namespace GemRB {
 
 typedef std::vector< char*> RowEntry;
 
+// case insensitive name -> index map for row and column names
+class NameIndex : public HashMap<std::string, unsigned int> {
+public:
+	// lookup without std::string construction, -1 if not found
+	int find(const char *key) const
+	{
+		if (!isInitialized())
+			return -1;
+
+		incAccesses();
+
+		for (Entry *e = getBucketByHash(HashKey<std::string>::hash(key)); e; e = e->next)
+			if (HashKey<std::string>::equals(e->key, key))
+				return (int) e->value;
+
+		return -1;
+	}
+};
+
 class p2DAImporter : public TableMgr {
 private:
 	std::vector< char*> colNames;
 	std::vector< char*> rowNames;
 	std::vector< char*> ptrs;
 	std::vector< RowEntry> rows;
+	NameIndex colIndex;
+	NameIndex rowIndex;
 	char defVal[32];
+
+	static void BuildIndex(NameIndex& index, const std::vector< char*>& names);
 public:
 	p2DAImporter(void);
 	~p2DAImporter(void);
@@ -105,22 +129,12 @@ public:
 
 	inline int GetRowIndex(const char* string) const
 	{
-		for (unsigned int index = 0; index < rowNames.size(); index++) {
-			if (stricmp( rowNames[index], string ) == 0) {
-				return (int) index;
-			}
-		}
-		return -1;
+		return rowIndex.find(string);
 	}
 
 	inline int GetColumnIndex(const char* string) const
 	{
-		for (unsigned int index = 0; index < colNames.size(); index++) {
-			if (stricmp( colNames[index], string ) == 0) {
-				return (int) index;
-			}
-		}
-		return -1;
+		return colIndex.find(string);
 	}
 
 	inline const char* GetColumnName(unsigned int index) const
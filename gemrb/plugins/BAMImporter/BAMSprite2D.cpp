@@ -53,6 +53,7 @@ BAMSprite2D::BAMSprite2D(const BAMSprite2D &obj)
 	source->IncDataRefCount();
 	BAM = true;
 	freePixels = false; // managed by datasrc
+	checkpoints = obj.checkpoints;
 }
 
 BAMSprite2D* BAMSprite2D::copy() const
@@ -84,6 +85,41 @@ void BAMSprite2D::SetPalette(Palette* palette)
 	pal = palette;
 }
 
+void BAMSprite2D::SetColorKey(ieDword ck)
+{
+	if (colorkey != (ieByte) ck) {
+		// the runs are of the colorkey
+		checkpoints.clear();
+	}
+	colorkey = (ieByte) ck;
+}
+
+/** Lets the blitters and GetPixel start decoding right where they need */
+const RLECheckpoint* BAMSprite2D::GetRLECheckpoints() const
+{
+	if (!RLE || Width <= 0 || Height <= 0) {
+		return NULL;
+	}
+	if (checkpoints.empty()) {
+		int perRow = (Width + RLE_CHECKPOINT_STEP - 1) / RLE_CHECKPOINT_STEP;
+		checkpoints.resize(perRow * Height);
+		const ieByte *rle = (const ieByte*)pixels;
+		int pos = 0; // the first pixel of the run at rle
+		for (size_t i = 0; i < checkpoints.size(); i++) {
+			int target = (i / perRow) * Width + (i % perRow) * RLE_CHECKPOINT_STEP;
+			while (true) {
+				int count = *rle == colorkey ? rle[1] + 1 : 1;
+				if (pos + count > target) break;
+				rle += *rle == colorkey ? 2 : 1;
+				pos += count;
+			}
+			checkpoints[i].offset = rle - (const ieByte*)pixels;
+			checkpoints[i].start = pos - target;
+		}
+	}
+	return &checkpoints[0];
+}
+
 Color BAMSprite2D::GetPixel(unsigned short x, unsigned short y) const
 {
 	Color c = { 0, 0, 0, 0 };
@@ -98,6 +134,11 @@ Color BAMSprite2D::GetPixel(unsigned short x, unsigned short y) const
 
 	const ieByte *rle = (const ieByte*)pixels;
 	if (RLE) {
+		const RLECheckpoint *checkpoints = GetRLECheckpoints();
+		int perRow = (Width + RLE_CHECKPOINT_STEP - 1) / RLE_CHECKPOINT_STEP;
+		const RLECheckpoint &checkpoint = checkpoints[y * perRow + x / RLE_CHECKPOINT_STEP];
+		rle += checkpoint.offset;
+		skipcount = x % RLE_CHECKPOINT_STEP - checkpoint.start;
 		while (skipcount > 0) {
 			if (*rle++ == colorkey)
 				skipcount -= (*rle++)+1;
@@ -23,6 +23,8 @@
 
 #include "Sprite2D.h"
 
+#include <vector>
+
 namespace GemRB {
 
 class AnimationFactory;
@@ -34,6 +36,8 @@ private:
 	// The AnimationFactory in which the data for this sprite is stored.
 	// (Used for refcounting of the data.)
 	AnimationFactory* source;
+	// built on first use, the row and column checkpoints of the RLE data
+	mutable std::vector<RLECheckpoint> checkpoints;
 public:
 	// all BAMs have a palette and colorkey so force them at construction
 	// for BAMs the actual colorkey is always green (RGB(0,255,0)) so use colorkey to store the transparency index
@@ -49,7 +53,8 @@ public:
 	void SetPalette(Palette *pal);
 	Color GetPixel(unsigned short x, unsigned short y) const;
 	ieDword GetColorKey() const { return colorkey; };
-	void SetColorKey(ieDword ck) { colorkey = (ieByte)ck; };
+	void SetColorKey(ieDword ck);
+	const RLECheckpoint* GetRLECheckpoints() const;
 };
 
 }
@@ -26,12 +26,19 @@
 #include "PluginMgr.h"
 #include "System/SlicedStream.h"
 #include "System/FileStream.h"
+#include "System/MemoryStream.h"
 #if defined(SUPPORTS_MEMSTREAM)
 #include "System/MappedFileMemoryStream.h"
 #endif
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 using namespace GemRB;
 
+#define INVALID_ENTRY 0xffffffff
+
 BIFImporter::BIFImporter(void)
 {
 	stream = NULL;
@@ -53,37 +60,195 @@ BIFImporter::~BIFImporter(void)
 	}
 }
 
+// upper bound for the worker threads inflating BIFC blocks
+#define MAX_INFLATE_THREADS 8
+
+// inflates the blocks from first on with a small worker pool and appends them
+// to out in their original order, so the written part is always a valid prefix
+bool BIFImporter::InflateBlocks(DataStream* compressed, DataStream* out, const std::vector<BIFCBlock>& blocks, size_t first)
+{
+	PluginHolder<Compressor> comp(PLUGIN_COMPRESSION_ZLIB);
+	const Compressor *inflater = comp.get();
+
+	size_t threadCount = std::thread::hardware_concurrency();
+	threadCount = Clamp<size_t>(threadCount, 1, MAX_INFLATE_THREADS);
+	threadCount = std::min(threadCount, blocks.size() - first);
+	// don't let the workers get too far ahead of the writer
+	size_t window = 2 * threadCount;
+
+	std::vector<DataStream*> results(blocks.size(), nullptr);
+	std::mutex lock;
+	std::condition_variable cv;
+	size_t next = first;
+	size_t written = first;
+	bool failed = false;
+
+	auto worker = [&]() {
+		DataStream* source = compressed->Clone();
+		while (true) {
+			size_t i;
+			{
+				std::unique_lock<std::mutex> l(lock);
+				cv.wait(l, [&] { return failed || next >= blocks.size() || next < written + window; });
+				if (failed || next >= blocks.size()) break;
+				i = next++;
+			}
+
+			const BIFCBlock& block = blocks[i];
+			DataStream* inflated = new MemoryStream(compressed->originalfile, malloc(block.declen), block.declen);
+			bool ok = source && source->Seek(block.offset, GEM_STREAM_START) == GEM_OK &&
+				inflater->Decompress(inflated, source, block.complen) == GEM_OK &&
+				inflated->GetPos() == block.declen;
+
+			std::lock_guard<std::mutex> l(lock);
+			if (ok) {
+				results[i] = inflated;
+			} else {
+				delete inflated;
+				failed = true;
+			}
+			cv.notify_all();
+		}
+		delete source;
+	};
+
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threadCount; t++) {
+		workers.emplace_back(worker);
+	}
+
+	std::vector<char> storage;
+	while (written < blocks.size()) {
+		DataStream* inflated;
+		{
+			std::unique_lock<std::mutex> l(lock);
+			cv.wait(l, [&] { return failed || results[written]; });
+			if (failed) break;
+			inflated = results[written];
+			results[written] = nullptr;
+		}
+
+		inflated->Rewind();
+		const char* data = inflated->ReadSpan(blocks[written].declen, storage);
+		bool ok = data && out->Write(data, blocks[written].declen) != GEM_ERROR;
+		delete inflated;
+
+		std::lock_guard<std::mutex> l(lock);
+		if (!ok) {
+			failed = true;
+		} else {
+			written++;
+		}
+		cv.notify_all();
+	}
+
+	for (auto& thread : workers) {
+		thread.join();
+	}
+	for (auto inflated : results) {
+		delete inflated;
+	}
+	return !failed;
+}
+
+// identifies the archive a partial cache was inflated from: its size and a
+// hash (FNV-1a) of its block table
+static void PartSource(DataStream* compressed, const std::vector<BIFCBlock>& blocks, ieDword source[2])
+{
+	ieDword hash = 2166136261U;
+	for (const BIFCBlock& block : blocks) {
+		const ieDword fields[3] = { block.offset, block.complen, block.declen };
+		for (ieDword field : fields) {
+			for (int b = 0; b < 32; b += 8) {
+				hash = (hash ^ ((field >> b) & 0xff)) * 16777619U;
+			}
+		}
+	}
+	source[0] = (ieDword) compressed->Size();
+	source[1] = hash;
+}
+
+// whether the sidecar of a partial cache names the same source archive
+static bool SamePartSource(const char* srcPath, const ieDword source[2])
+{
+	FileStream file;
+	if (!file_exists(srcPath) || !file.Open(srcPath)) {
+		return false;
+	}
+	ieDword stored[2];
+	return file.ReadDword(&stored[0]) != GEM_ERROR && file.ReadDword(&stored[1]) != GEM_ERROR &&
+		stored[0] == source[0] && stored[1] == source[1];
+}
+
+static bool WritePartSource(const char* srcPath, const ieDword source[2])
+{
+	FileStream file;
+	return file.Create(srcPath) && file.WriteDword(&source[0]) != GEM_ERROR &&
+		file.WriteDword(&source[1]) != GEM_ERROR;
+}
+
 DataStream* BIFImporter::DecompressBIFC(DataStream* compressed, const char* path)
 {
 	print("Decompressing");
 	if (!core->IsAvailable( PLUGIN_COMPRESSION_ZLIB ))
 		return NULL;
-	PluginHolder<Compressor> comp(PLUGIN_COMPRESSION_ZLIB);
 	ieDword unCompBifSize;
 	compressed->ReadDword( &unCompBifSize );
-#if !defined(SUPPORTS_MEMSTREAM)
-	fflush(stdout);
-#endif
-	FileStream out;
-	if (!out.Create(path)) {
-		Log(ERROR, "BIFImporter", "Cannot write %s.", path);
-		return NULL;
-	}
+
+	// collect the block layout first, so they can be inflated independently
+	std::vector<BIFCBlock> blocks;
 	ieDword finalsize = 0;
-	int laststep = 0;
 	while (finalsize < unCompBifSize) {
-		ieDword complen, declen;
-		compressed->ReadDword( &declen );
-		compressed->ReadDword( &complen );
-		if (comp->Decompress( &out, compressed, complen ) != GEM_OK) {
+		BIFCBlock block;
+		compressed->ReadDword( &block.declen );
+		if (compressed->ReadDword( &block.complen ) == GEM_ERROR || !block.declen) {
+			Log(ERROR, "BIFImporter", "Corrupt compressed archive %s.", compressed->originalfile);
 			return NULL;
 		}
-		finalsize = out.GetPos();
-		if (( int ) ( finalsize * ( 10.0 / unCompBifSize ) ) != laststep) {
-			laststep++;
+		block.offset = compressed->GetPos();
+		block.target = finalsize;
+		if (compressed->Seek(block.complen, GEM_CURRENT_POS) == GEM_ERROR) {
+			Log(ERROR, "BIFImporter", "Truncated compressed archive %s.", compressed->originalfile);
+			return NULL;
 		}
+		finalsize += block.declen;
+		blocks.push_back(block);
+	}
+
+	// decompress into a separate file and only rename it once it is complete,
+	// so an interrupted run leaves a partial cache we can resume from; the
+	// sidecar makes sure it is only resumed from the very same archive
+	char partPath[_MAX_PATH];
+	char srcPath[_MAX_PATH];
+	snprintf(partPath, _MAX_PATH, "%s.part", path);
+	snprintf(srcPath, _MAX_PATH, "%s.part.src", path);
+	ieDword source[2];
+	PartSource(compressed, blocks, source);
+
+	FileStream out;
+	size_t first = 0;
+	if (file_exists(partPath) && SamePartSource(srcPath, source) && out.Modify(partPath) && out.Size() <= finalsize) {
+		// skip the blocks that already made it to disk completely
+		while (first < blocks.size() && blocks[first].target + blocks[first].declen <= out.Size()) {
+			first++;
+		}
+		ieDword resumeAt = first < blocks.size() ? blocks[first].target : finalsize;
+		out.Seek(resumeAt, GEM_STREAM_START);
+		Log(MESSAGE, "BIFImporter", "Resuming %s at block %d/%d.", path, (int) first, (int) blocks.size());
+	} else if (!out.Create(partPath) || !WritePartSource(srcPath, source)) {
+		Log(ERROR, "BIFImporter", "Cannot write %s.", partPath);
+		return NULL;
+	}
+
+	if (!InflateBlocks(compressed, &out, blocks, first)) {
+		return NULL;
 	}
 	out.Close(); // This is necesary, since windows won't open the file otherwise.
+	if (rename(partPath, path)) {
+		Log(ERROR, "BIFImporter", "Cannot rename %s to %s.", partPath, path);
+		return NULL;
+	}
+	remove(srcPath);
 #if defined(SUPPORTS_MEMSTREAM)
 	return new MappedFileMemoryStream{path};
 #else
@@ -173,25 +338,48 @@ int BIFImporter::OpenArchive(const char* path)
 DataStream* BIFImporter::GetStream(unsigned long Resource, unsigned long Type)
 {
 	if (Type == IE_TIS_CLASS_ID) {
-		unsigned int srcResLoc = Resource & 0xFC000;
-		for (unsigned int i = 0; i < tentcount; i++) {
-			if (( tentries[i].resLocator & 0xFC000 ) == srcResLoc) {
-				return SliceStream( stream, tentries[i].dataOffset,
-							tentries[i].tileSize * tentries[i].tilesCount );
-			}
+		unsigned int srcResLoc = (Resource & 0xFC000) >> 14;
+		if (srcResLoc < tindex.size() && tindex[srcResLoc] != INVALID_ENTRY) {
+			const TileEntry &entry = tentries[tindex[srcResLoc]];
+			return SliceStream(stream, entry.dataOffset, entry.tileSize * entry.tilesCount);
 		}
 	} else {
 		ieDword srcResLoc = Resource & 0x3FFF;
-		for (ieDword i = 0; i < fentcount; i++) {
-			if (( fentries[i].resLocator & 0x3FFF ) == srcResLoc) {
-				return SliceStream( stream, fentries[i].dataOffset,
-							fentries[i].fileSize );
-			}
+		if (srcResLoc < findex.size() && findex[srcResLoc] != INVALID_ENTRY) {
+			const FileEntry &entry = fentries[findex[srcResLoc]];
+			return SliceStream(stream, entry.dataOffset, entry.fileSize);
 		}
 	}
 	return NULL;
 }
 
+void BIFImporter::IndexEntries(void)
+{
+	// the locators are usually just sequential, so a direct table is enough;
+	// keep the first match for duplicates, like the old linear search did
+	findex.clear();
+	tindex.clear();
+	ieDword i;
+	for (i = 0; i < fentcount; i++) {
+		ieDword loc = fentries[i].resLocator & 0x3FFF;
+		if (loc >= findex.size()) {
+			findex.resize(loc + 1, INVALID_ENTRY);
+		}
+		if (findex[loc] == INVALID_ENTRY) {
+			findex[loc] = i;
+		}
+	}
+	for (i = 0; i < tentcount; i++) {
+		ieDword loc = (tentries[i].resLocator & 0xFC000) >> 14;
+		if (loc >= tindex.size()) {
+			tindex.resize(loc + 1, INVALID_ENTRY);
+		}
+		if (tindex[loc] == INVALID_ENTRY) {
+			tindex[loc] = i;
+		}
+	}
+}
+
 void BIFImporter::ReadBIF(void)
 {
 	ieDword foffset;
@@ -212,23 +400,38 @@ void BIFImporter::ReadBIF(void)
 		}
 		return;
 	}
+	// decode both tables in one go, straight from the mapped file if possible
+	std::vector<char> storage;
+	const char* table = NULL;
+	if (fentcount || tentcount) {
+		table = stream->ReadSpan(16 * fentcount + 20 * tentcount, storage);
+	}
+	if (!table) {
+		fentcount = tentcount = 0;
+		IndexEntries();
+		return;
+	}
 	unsigned int i;
 
 	for (i=0;i<fentcount;i++) {
-		stream->ReadDword( &fentries[i].resLocator);
-		stream->ReadDword( &fentries[i].dataOffset);
-		stream->ReadDword( &fentries[i].fileSize);
-		stream->ReadWord( &fentries[i].type);
-		stream->ReadWord( &fentries[i].u1);
+		const char* entry = table + 16 * i;
+		fentries[i].resLocator = DataStream::DwordAt(entry);
+		fentries[i].dataOffset = DataStream::DwordAt(entry + 4);
+		fentries[i].fileSize = DataStream::DwordAt(entry + 8);
+		fentries[i].type = DataStream::WordAt(entry + 12);
+		fentries[i].u1 = DataStream::WordAt(entry + 14);
 	}
+	table += 16 * fentcount;
 	for (i=0;i<tentcount;i++) {
-		stream->ReadDword( &tentries[i].resLocator);
-		stream->ReadDword( &tentries[i].dataOffset);
-		stream->ReadDword( &tentries[i].tilesCount);
-		stream->ReadDword( &tentries[i].tileSize);
-		stream->ReadWord( &tentries[i].type);
-		stream->ReadWord( &tentries[i].u1);
+		const char* entry = table + 20 * i;
+		tentries[i].resLocator = DataStream::DwordAt(entry);
+		tentries[i].dataOffset = DataStream::DwordAt(entry + 4);
+		tentries[i].tilesCount = DataStream::DwordAt(entry + 8);
+		tentries[i].tileSize = DataStream::DwordAt(entry + 12);
+		tentries[i].type = DataStream::WordAt(entry + 16);
+		tentries[i].u1 = DataStream::WordAt(entry + 18);
 	}
+	IndexEntries();
 }
 
 #include "plugindef.h"
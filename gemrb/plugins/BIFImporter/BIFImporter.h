@@ -27,6 +27,8 @@
 
 #include "System/DataStream.h"
 
+#include <vector>
+
 namespace GemRB {
 
 struct FileEntry {
@@ -46,11 +48,21 @@ struct TileEntry {
 	ieWord  u1; //Unknown Field
 };
 
+// one independently compressed block of a BIFC archive
+struct BIFCBlock {
+	ieDword offset; // of the compressed data in the archive
+	ieDword complen;
+	ieDword declen;
+	ieDword target; // of the decompressed data in the cached bif
+};
+
 class BIFImporter : public IndexedArchive {
 private:
 	FileEntry* fentries;
 	TileEntry* tentries;
 	ieDword fentcount, tentcount;
+	// locator index -> entry index, so lookups don't need to scan the tables
+	std::vector<ieDword> findex, tindex;
 	DataStream* stream;
 public:
 	BIFImporter(void);
@@ -60,7 +72,9 @@ public:
 private:
 	static DataStream* DecompressBIF(DataStream* compressed, const char* path);
 	static DataStream* DecompressBIFC(DataStream* compressed, const char* path);
+	static bool InflateBlocks(DataStream* compressed, DataStream* out, const std::vector<BIFCBlock>& blocks, size_t first);
 	void ReadBIF(void);
+	void IndexEntries(void);
 };
 
 }
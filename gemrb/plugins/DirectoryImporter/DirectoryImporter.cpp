@@ -29,6 +29,8 @@ using namespace GemRB;
 DirectoryImporter::DirectoryImporter(void)
 {
 	description = NULL;
+	listingTime = 0;
+	listingValid = false;
 }
 
 DirectoryImporter::~DirectoryImporter(void)
@@ -50,51 +52,109 @@ bool DirectoryImporter::Open(const char *dir, const char *desc)
 	return true;
 }
 
-static bool FindIn(const char *Path, const char *ResRef, const char *Type)
+// returns false if the snapshot can't be trusted, so the caller has to ask the filesystem
+bool DirectoryImporter::RefreshListing()
 {
-	char p[_MAX_PATH], f[_MAX_PATH] = {0};
-	if (strlcpy(f, ResRef, _MAX_PATH) >= _MAX_PATH) {
-		Log(ERROR, "DirectoryImporter", "Too long filename: %s!", ResRef);
+	struct stat st;
+	if (stat(path, &st) < 0) {
 		return false;
 	}
-	strlwr(f);
+	if (listingValid && st.st_mtime == listingTime) {
+		return true;
+	}
+
+	// mtimes can be as coarse as a second, so a directory that changed just now
+	// could change again without us noticing; wait until it settles
+	if (time(NULL) <= st.st_mtime + 1) {
+		listingValid = false;
+		return false;
+	}
+
+	DirectoryIterator it(path);
+	if (!it) {
+		listingValid = false;
+		return false;
+	}
+
+	unsigned int count = 0;
+	do {
+		if (!it.IsDirectory()) count++;
+	} while (++it);
+	// + 1 keeps the map usable for empty directories
+	listing.init(count > 4 * 1024 ? 4 * 1024 : count + 1, count + 1);
 
-	return PathJoinExt(p, Path, f, Type);
+	it.Rewind();
+	if (it) {
+		char buf[_MAX_PATH];
+		do {
+			if (it.IsDirectory())
+				continue;
+			const char *name = it.GetName();
+			strnlwrcpy(buf, name, _MAX_PATH, false);
+			// like FindInDir, prefer the lowercase name if several only differ by case
+			const std::string *old = listing.get(buf);
+			if (!old || strcmp(buf, name) == 0) {
+				listing.set(buf, name);
+			}
+		} while (++it);
+	}
+
+	listingTime = st.st_mtime;
+	listingValid = true;
+	return true;
 }
 
-static FileStream *SearchIn(const char * Path,const char * ResRef, const char *Type)
+bool DirectoryImporter::FindFile(const char* resname, const char* ext, char* fullPath)
 {
-	char p[_MAX_PATH], f[_MAX_PATH] = {0};
-	if (strlcpy(f, ResRef, _MAX_PATH) >= _MAX_PATH) {
-		Log(ERROR, "DirectoryImporter", "Too long filename2: %s!", ResRef);
-		return NULL;
+	char filename[_MAX_PATH];
+	if (snprintf(filename, _MAX_PATH, "%s.%s", resname, ext) >= _MAX_PATH) {
+		Log(ERROR, "DirectoryImporter", "Too long filename: %s!", resname);
+		return false;
+	}
+	strlwr(filename);
+
+	{
+		std::lock_guard<std::mutex> l(listingLock);
+		if (RefreshListing()) {
+			const std::string *s = listing.get(filename);
+			if (!s) {
+				return false;
+			}
+			strcpy(fullPath, path);
+			PathAppend(fullPath, s->c_str());
+			return true;
+		}
 	}
-	strlwr(f);
-
-	if (!PathJoinExt(p, Path, f, Type))
-		return NULL;
 
-	return FileStream::OpenFile(p);
+	return PathJoin(fullPath, path, filename, nullptr);
 }
 
 bool DirectoryImporter::HasResource(const char* resname, SClass_ID type)
 {
-	return FindIn( path, resname, core->TypeExt(type) );
+	char fullPath[_MAX_PATH];
+	return FindFile(resname, core->TypeExt(type), fullPath);
 }
 
 bool DirectoryImporter::HasResource(const char* resname, const ResourceDesc &type)
 {
-	return FindIn( path, resname, type.GetExt() );
+	char fullPath[_MAX_PATH];
+	return FindFile(resname, type.GetExt(), fullPath);
 }
 
 DataStream* DirectoryImporter::GetResource(const char* resname, SClass_ID type)
 {
-	return SearchIn( path, resname, core->TypeExt(type) );
+	char fullPath[_MAX_PATH];
+	if (!FindFile(resname, core->TypeExt(type), fullPath))
+		return NULL;
+	return FileStream::OpenFile(fullPath);
 }
 
 DataStream* DirectoryImporter::GetResource(const char* resname, const ResourceDesc &type)
 {
-	return SearchIn( path, resname, type.GetExt() );
+	char fullPath[_MAX_PATH];
+	if (!FindFile(resname, type.GetExt(), fullPath))
+		return NULL;
+	return FileStream::OpenFile(fullPath);
 }
 
 CachedDirectoryImporter::CachedDirectoryImporter()
@@ -118,6 +178,7 @@ bool CachedDirectoryImporter::Open(const char *dir, const char *desc)
 void CachedDirectoryImporter::Refresh()
 {
 	cache.clear();
+	revision++;
 
 	DirectoryIterator it(path);
 	if (!it)
@@ -22,6 +22,9 @@
 #include "ResourceSource.h"
 #include "StringMap.h"
 
+#include <ctime>
+#include <mutex>
+
 namespace GemRB {
 
 class Resource;
@@ -30,11 +33,22 @@ class ResourceDesc;
 class DirectoryImporter : public ResourceSource {
 protected:
 	char path[_MAX_PATH];
+	// snapshot of the directory contents, valid while the directory mtime stays the same
+	StringMap listing;
+	time_t listingTime;
+	bool listingValid;
+	std::mutex listingLock;
+
+	bool RefreshListing();
+	/** Returns the full path of resname.ext in fullPath, or false if it doesn't exist */
+	bool FindFile(const char* resname, const char* ext, char* fullPath);
 
 public:
 	DirectoryImporter(void);
 	~DirectoryImporter(void);
 	bool Open(const char *dir, const char *desc);
+	/** files can come and go at any time */
+	bool IsVolatile() const { return true; }
 	/** predicts the availability of a resource */
 	bool HasResource(const char* resname, SClass_ID type);
 	bool HasResource(const char* resname, const ResourceDesc &type);
@@ -53,6 +67,8 @@ public:
 
 	bool Open(const char *dir, const char *desc);
 	void Refresh();
+	/** only changes on Refresh */
+	bool IsVolatile() const { return false; }
 	/** predicts the availability of a resource */
 	bool HasResource(const char* resname, SClass_ID type);
 	bool HasResource(const char* resname, const ResourceDesc &type);
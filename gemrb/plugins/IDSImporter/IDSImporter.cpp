@@ -80,27 +80,52 @@ bool IDSImporter::Open(DataStream* str)
 	}
 
 	delete str;
+	BuildIndices();
 	return true;
 }
 
-int IDSImporter::GetValue(const char* txt) const
+void IDSImporter::BuildIndices()
 {
-	for (unsigned int i = 0; i < pairs.size(); i++) {
-		if (stricmp( pairs[i].str, txt ) == 0) {
-			return pairs[i].val;
+	unsigned int count = (unsigned int) pairs.size();
+	unsigned int tableSize = count > 1024 ? 1024 : count + 1;
+	firstSymbol.init(tableSize, count + 1);
+	firstValue.init(tableSize, count + 1);
+	lastValue.init(tableSize, count + 1);
+	lastCall.init(tableSize, count + 1);
+
+	for (unsigned int i = 0; i < count; i++) {
+		const Pair &p = pairs[i];
+		size_t len = strlen(p.str);
+		if (firstSymbol.find(p.str, len) < 0) {
+			firstSymbol.set(p.str, i);
+		}
+		if (!firstValue.has(p.val)) {
+			firstValue.set(p.val, i);
+		}
+		lastValue.set(p.val, i);
+		const char *paren = strchr(p.str, '(');
+		if (paren) {
+			lastCall.set(std::string(p.str, paren - p.str + 1), i);
 		}
 	}
-	return -1;
+}
+
+int IDSImporter::GetValue(const char* txt) const
+{
+	int i = firstSymbol.find(txt, strlen(txt));
+	if (i < 0) {
+		return -1;
+	}
+	return pairs[i].val;
 }
 
 char* IDSImporter::GetValue(int val) const
 {
-	for (unsigned int i = 0; i < pairs.size(); i++) {
-		if (pairs[i].val == val) {
-			return pairs[i].str;
-		}
+	const int *i = firstValue.get(val);
+	if (!i) {
+		return NULL;
 	}
-	return NULL;
+	return pairs[*i].str;
 }
 
 char* IDSImporter::GetStringIndex(unsigned int Index) const
@@ -121,6 +146,11 @@ int IDSImporter::GetValueIndex(unsigned int Index) const
 
 int IDSImporter::FindString(char *str, int len) const
 {
+	// the script compiler looks up "name(", which is indexed
+	if (len > 0 && (int) strnlen(str, len) == len && str[len - 1] == '(' && !memchr(str, '(', len - 1)) {
+		return lastCall.find(str, len);
+	}
+
 	int i=pairs.size();
 	while(i--) {
 		if (strnicmp(pairs[i].str, str, len) == 0) {
@@ -132,13 +162,11 @@ int IDSImporter::FindString(char *str, int len) const
 
 int IDSImporter::FindValue(int val) const
 {
-	int i=pairs.size();
-	while(i--) {
-		if(pairs[i].val==val) {
-			return i;
-		}
+	const int *i = lastValue.get(val);
+	if (!i) {
+		return -1;
 	}
-	return -1;
+	return *i;
 }
 
 int IDSImporter::GetHighestValue() const
@@ -23,6 +23,8 @@
 
 #include "SymbolMgr.h"
 
+#include "StringMap.h"
+
 #include <vector>
 
 namespace GemRB {
@@ -32,10 +34,41 @@ struct Pair {
 	char* str;
 };
 
+// case insensitive symbol -> index map
+class SymbolIndex : public HashMap<std::string, int> {
+public:
+	// lookup of the first len characters of key, -1 if not found
+	int find(const char *key, size_t len) const
+	{
+		if (!isInitialized())
+			return -1;
+
+		incAccesses();
+
+		unsigned int h = 0;
+		for (size_t i = 0; i < len; i++)
+			h = (h << 5) + h + tolower(key[i]);
+
+		for (Entry *e = getBucketByHash(h); e; e = e->next)
+			if (e->key.length() == len && strnicmp(e->key.c_str(), key, len) == 0)
+				return e->value;
+
+		return -1;
+	}
+};
+
 class IDSImporter : public SymbolMgr {
 private:
 	std::vector< Pair> pairs;
 	std::vector< char*> ptrs;
+	// first index of each symbol and value, for GetValue
+	SymbolIndex firstSymbol;
+	HashMap<int, int> firstValue;
+	// last index of each value and of each "name(" prefix, for FindValue and FindString
+	HashMap<int, int> lastValue;
+	SymbolIndex lastCall;
+
+	void BuildIndices();
 
 public:
 	IDSImporter(void);
@@ -26,16 +26,59 @@
 #include "Interface.h"
 #include "ResourceDesc.h"
 #include "System/FileStream.h"
+#if defined(SUPPORTS_MEMSTREAM)
+#include "System/MappedFileMemoryStream.h"
+#endif
+
+#include <chrono>
+#ifdef WIN32
+#include "win32def.h"
+#else
+#include <sys/resource.h>
+#endif
 
 using namespace GemRB;
 
+// how many archives we keep open at once
+#define MAX_OPEN_BIFS 16
+// breather for the game thread and the disk between two precached archives (ms)
+#define WARMUP_PAUSE 50
+
+// Lets the game thread go first. Windows and Linux keep the priority per
+// thread; elsewhere it would slow the whole game down, so there we only
+// rely on the pauses between archives.
+static void LowerThreadPriority()
+{
+#ifdef WIN32
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(__linux__)
+	setpriority(PRIO_PROCESS, 0, 10);
+#endif
+}
+
 KEYImporter::KEYImporter(void)
 {
 	description = NULL;
+	cacheTick = 0;
+	cacheHits = cacheMisses = 0;
+	warmupCurrent = 0xffffffff;
+	warmupStop = false;
 }
 
 KEYImporter::~KEYImporter(void)
 {
+	if (warmupThread.joinable()) {
+		{
+			std::lock_guard<std::mutex> l(warmupLock);
+			warmupStop = true;
+			warmupQueue.clear();
+		}
+		// an archive that is already being inflated is finished first
+		warmupThread.join();
+	}
+	if (cacheHits || cacheMisses) {
+		Log(DEBUG, "KEYImporter", "Archive cache: %u hits, %u misses.", cacheHits, cacheMisses);
+	}
 	free(description);
 	for (unsigned int i = 0; i < biffiles.size(); i++) {
 		free( biffiles[i].name );
@@ -119,9 +162,18 @@ bool KEYImporter::Open(const char *resfile, const char *desc)
 		return false;
 	}
 	unsigned int i;
+	unsigned long startTime = GetTicks();
 	// NOTE: Interface::Init has already resolved resfile.
 	Log(MESSAGE, "KEYImporter", "Opening %s...", resfile);
+#if defined(SUPPORTS_MEMSTREAM)
+	MappedFileMemoryStream* f = new MappedFileMemoryStream{resfile};
+	if (!f->isOk()) {
+		delete f;
+		f = NULL;
+	}
+#else
 	FileStream* f = FileStream::OpenFile(resfile);
+#endif
 	if (!f) {
 		// Check for backslashes (false escape characters)
 		// this check probably belongs elsewhere (e.g. ResolveFilePath)
@@ -151,17 +203,26 @@ bool KEYImporter::Open(const char *resfile, const char *desc)
 			BifCount, BifOffset );
 	Log(MESSAGE, "KEYImporter", "RES Count: %d (Starting at %d Bytes)",
 		ResCount, ResOffset);
-	f->Seek( BifOffset, GEM_STREAM_START );
 
-	ieDword BifLen, ASCIIZOffset;
-	ieWord ASCIIZLen;
+	// both tables are decoded in bulk, straight from the mapped file if possible
+	std::vector<char> storage;
+	const char* table = NULL;
+	if (BifCount) {
+		f->Seek( BifOffset, GEM_STREAM_START );
+		table = f->ReadSpan(12 * BifCount, storage);
+		if (!table) {
+			Log(ERROR, "KEYImporter", "Cannot read the BIF table.");
+			delete( f );
+			return false;
+		}
+	}
+
 	for (i = 0; i < BifCount; i++) {
 		BIFEntry be;
-		f->Seek( BifOffset + ( 12 * i ), GEM_STREAM_START );
-		f->ReadDword( &BifLen );
-		f->ReadDword( &ASCIIZOffset );
-		f->ReadWord( &ASCIIZLen );
-		f->ReadWord( &be.BIFLocator );
+		const char* entry = table + 12 * i;
+		ieDword ASCIIZOffset = DataStream::DwordAt(entry + 4);
+		ieWord ASCIIZLen = DataStream::WordAt(entry + 8);
+		be.BIFLocator = DataStream::WordAt(entry + 10);
 		be.name = ( char * ) malloc( ASCIIZLen );
 		f->Seek( ASCIIZOffset, GEM_STREAM_START );
 		f->Read( be.name, ASCIIZLen );
@@ -173,7 +234,6 @@ bool KEYImporter::Open(const char *resfile, const char *desc)
 		FindBIF(&be);
 		biffiles.push_back( be );
 	}
-	f->Seek( ResOffset, GEM_STREAM_START );
 
 	MapKey key;
 	ieDword ResLocator;
@@ -182,21 +242,112 @@ bool KEYImporter::Open(const char *resfile, const char *desc)
 	// only ~1% of the bg2 entries are of bucket lenght >4
 	resources.init(ResCount > 32 * 1024 ? 32 * 1024 : ResCount, ResCount);
 
+	if (ResCount) {
+		f->Seek( ResOffset, GEM_STREAM_START );
+		table = f->ReadSpan(14 * ResCount, storage);
+		if (!table) {
+			Log(ERROR, "KEYImporter", "Cannot read the resource table.");
+			delete( f );
+			return false;
+		}
+	}
+
 	for (i = 0; i < ResCount; i++) {
-		f->ReadResRef(key.ref);
-		f->ReadWord(&key.type);
-		f->ReadDword(&ResLocator);
+		const char* entry = table + 14 * i;
+		// same normalisation as ReadResRef
+		for (int c = 0; c < 8; c++) {
+			key.ref[c] = (char) tolower(entry[c]);
+		}
+		for (int c = 7; c >= 0 && key.ref[c] == ' '; c--) {
+			key.ref[c] = 0;
+		}
+		key.ref[8] = 0;
+		key.type = DataStream::WordAt(entry + 8);
+		ResLocator = DataStream::DwordAt(entry + 10);
 
 		// seems to be always the last entry?
 		if (key.ref[0] != 0)
 			resources.set(key, ResLocator);
 	}
 
+	Log(MESSAGE, "KEYImporter", "Parsed %s in %lu ms.", resfile, GetTicks() - startTime);
 	Log(MESSAGE, "KEYImporter", "Resources Loaded...");
 	delete( f );
+
+	if (core->PrecacheArchives) {
+		for (i = 0; i < biffiles.size(); i++) {
+			if (biffiles[i].found) {
+				warmupQueue.push_back(i);
+			}
+		}
+		warmupThread = std::thread(&KEYImporter::WarmUpCache, this);
+	}
 	return true;
 }
 
+// the first request for a compressed archive inflates it, which can take
+// seconds, so optionally do them all ahead of time, one at a time
+void KEYImporter::WarmUpCache()
+{
+	LowerThreadPriority();
+	unsigned long startTime = GetTicks();
+	unsigned int count = 0;
+	while (true) {
+		unsigned int bifnum;
+		{
+			std::lock_guard<std::mutex> l(warmupLock);
+			if (warmupStop || warmupQueue.empty()) break;
+			bifnum = warmupQueue.front();
+			warmupQueue.pop_front();
+			warmupCurrent = bifnum;
+		}
+
+		char filename[_MAX_PATH];
+		char cachePath[_MAX_PATH];
+		ExtractFileFromPath(filename, biffiles[bifnum].path);
+		PathJoin(cachePath, core->CachePath, filename, nullptr);
+
+		// only plain BIFF archives can be used in place
+		char Signature[8];
+		FileStream file;
+		bool inflated = false;
+		if (!file_exists(cachePath) && file.Open(biffiles[bifnum].path) &&
+			file.Read(Signature, 8) == 8 && strncmp(Signature, "BIFFV1  ", 8) != 0) {
+			file.Close();
+			PluginHolder<IndexedArchive> ai(IE_BIF_CLASS_ID);
+			if (ai->OpenArchive(biffiles[bifnum].path) == GEM_ERROR) {
+				Log(WARNING, "KEYImporter", "Cannot precache archive %s", biffiles[bifnum].path);
+			} else {
+				inflated = true;
+				count++;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> l(warmupLock);
+			warmupCurrent = 0xffffffff;
+			warmupDone.notify_all();
+		}
+		if (inflated) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(WARMUP_PAUSE));
+		}
+	}
+	Log(MESSAGE, "KEYImporter", "Precached %u compressed archives in %lu ms.", count, GetTicks() - startTime);
+}
+
+void KEYImporter::ClaimArchive(unsigned int bifnum)
+{
+	if (!warmupThread.joinable()) return;
+
+	std::unique_lock<std::mutex> l(warmupLock);
+	// no need to wait for the rest of the queue, we'll open this one ourselves
+	std::deque<unsigned int>::iterator it = std::find(warmupQueue.begin(), warmupQueue.end(), bifnum);
+	if (it != warmupQueue.end()) {
+		warmupQueue.erase(it);
+	}
+	warmupDone.wait(l, [&] { return warmupCurrent != bifnum; });
+}
+
 bool KEYImporter::HasResource(const char* resname, SClass_ID type)
 {
 	return resources.has(resname, type);
@@ -207,6 +358,64 @@ bool KEYImporter::HasResource(const char* resname, const ResourceDesc &type)
 	return HasResource(resname, type.GetKeyType());
 }
 
+// looks the archive up in the pool, with cacheLock held
+static IndexedArchive *FindCachedArchive(std::vector<KEYCache>& bifcache, unsigned int bifnum, unsigned long tick)
+{
+	for (size_t i = 0; i < bifcache.size(); i++) {
+		if (bifcache[i].bifnum == bifnum) {
+			bifcache[i].lastUse = tick;
+			return bifcache[i].plugin.get();
+		}
+	}
+	return NULL;
+}
+
+IndexedArchive *KEYImporter::GetArchive(unsigned int bifnum, std::unique_lock<std::mutex>& l)
+{
+	cacheTick++;
+	IndexedArchive *cached = FindCachedArchive(bifcache, bifnum, cacheTick);
+	if (cached) {
+		cacheHits++;
+		return cached;
+	}
+	cacheMisses++;
+
+	// waiting for the warm-up and opening (maybe inflating) the archive can
+	// take seconds, don't keep the other readers out of the pool meanwhile
+	l.unlock();
+	ClaimArchive(bifnum);
+	PluginHolder<IndexedArchive> ai(IE_BIF_CLASS_ID);
+	bool opened = ai->OpenArchive( biffiles[bifnum].path ) != GEM_ERROR;
+	l.lock();
+
+	if (!opened) {
+		print("Cannot open archive %s", biffiles[bifnum].path);
+		return NULL;
+	}
+	// another thread may have opened it in the meantime
+	cached = FindCachedArchive(bifcache, bifnum, cacheTick);
+	if (cached) {
+		return cached;
+	}
+
+	// evict the least recently used archive once the pool is full
+	size_t victim = 0;
+	if (bifcache.size() < MAX_OPEN_BIFS) {
+		victim = bifcache.size();
+		bifcache.push_back(KEYCache());
+	} else {
+		for (size_t i = 1; i < bifcache.size(); i++) {
+			if (bifcache[i].lastUse < bifcache[victim].lastUse) {
+				victim = i;
+			}
+		}
+	}
+	bifcache[victim].bifnum = bifnum;
+	bifcache[victim].lastUse = cacheTick;
+	bifcache[victim].plugin = ai;
+	return ai.get();
+}
+
 DataStream* KEYImporter::GetStream(const char *resname, ieWord type)
 {
 	if (type == 0)
@@ -224,13 +433,15 @@ DataStream* KEYImporter::GetStream(const char *resname, ieWord type)
 		return NULL;
 	}
 
-	PluginHolder<IndexedArchive> ai(IE_BIF_CLASS_ID);
-	if (ai->OpenArchive( biffiles[bifnum].path ) == GEM_ERROR) {
-		print("Cannot open archive %s", biffiles[bifnum].path);
+	// the archives are shared, but sounds also get loaded from the audio threads
+	std::unique_lock<std::mutex> l(cacheLock);
+	IndexedArchive *ai = GetArchive(bifnum, l);
+	if (!ai) {
 		return NULL;
 	}
 
 	DataStream* ret = ai->GetStream( *ResLocator, type );
+	l.unlock();
 	if (ret) {
 		strnlwrcpy( ret->filename, resname, 8 );
 		strcat( ret->filename, "." );
@@ -28,6 +28,10 @@
 
 #include "StringMap.h"
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 namespace GemRB {
@@ -44,10 +48,12 @@ struct BIFEntry {
 	bool found;
 };
 
+// an open archive with its parsed entry tables, kept around between lookups
 struct KEYCache {
-	KEYCache() { bifnum = 0xffffffff; }
+	KEYCache() { bifnum = 0xffffffff; lastUse = 0; }
 
 	unsigned int bifnum;
+	unsigned long lastUse;
 	PluginHolder<IndexedArchive> plugin;
 };
 
@@ -130,9 +136,27 @@ class KEYImporter : public ResourceSource {
 private:
 	std::vector< BIFEntry> biffiles;
 	KEYImpMap resources;
+	// small LRU pool of open archives, so we don't reparse them on every fetch
+	std::vector<KEYCache> bifcache;
+	std::mutex cacheLock;
+	unsigned long cacheTick;
+	unsigned int cacheHits, cacheMisses;
+	// background decompression of compressed archives into the cache
+	std::thread warmupThread;
+	std::mutex warmupLock;
+	std::condition_variable warmupDone;
+	std::deque<unsigned int> warmupQueue;
+	unsigned int warmupCurrent;
+	bool warmupStop;
 
 	/** Gets the stream assoicated to a RESKey */
 	DataStream *GetStream(const char *resname, ieWord type);
+	/** Returns the (possibly cached) open archive for a bif index.
+	 * The caller holds cacheLock, it is dropped while a missing archive is opened. */
+	IndexedArchive *GetArchive(unsigned int bifnum, std::unique_lock<std::mutex>& l);
+	/** Makes sure the background warm-up isn't working on this archive */
+	void ClaimArchive(unsigned int bifnum);
+	void WarmUpCache();
 public:
 	KEYImporter(void);
 	~KEYImporter(void);
@@ -0,0 +1,192 @@
+/* GemRB - Infinity Engine Emulator
+ * Copyright (C) 2021 The GemRB Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ *
+ */
+
+// Span kernels: the alpha and halftrans blending of the 32bpp tile and
+// sprite renderers, done for a whole run of palette indices at once. The
+// palette is already expanded (and tinted) to the target format by the
+// caller, so a kernel only looks the pixels up and blends them. They give
+// exactly the same pixels as the per pixel blenders, just four at a time.
+// Whether they are used is decided once, at startup; without SSE2 the
+// kernels are NULL and the renderers keep blending pixel by pixel, as a
+// plain C loop over the span is no faster than that. Opaque pixels are
+// always left to the per pixel loops, there is nothing to gain there.
+
+// The kernels are built for any x86 target, but only used if the cpu has SSE2
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define SPAN_KERNELS_SSE2
+#define SSE2_TARGET __attribute__((target("sse2")))
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#define SPAN_KERNELS_SSE2
+#define SSE2_TARGET
+#endif
+
+#ifdef SPAN_KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// dst: the first pixel, the others follow in the xfactor direction (1 or -1)
+// src: count palette indices, pal and alpha: the expanded palette, with
+// the alpha repeated in every byte
+// the renderers only pass runs that no cover hides
+// mask: for alpha, the colour bits of the target format; for halftrans, the
+// bits left after halving a pixel
+typedef void (*SpanKernel32)(Uint32* dst, int xfactor, const Uint8* src, int count,
+	const Uint32* pal, const Uint32* alpha, Uint32 mask);
+
+#ifdef SPAN_KERNELS_SSE2
+
+// The scalar loops only do the few pixels left after the last group of four
+
+// like SRBlender_Alpha, for every byte of the pixel
+static inline Uint32 BlendAlpha32(Uint32 pix, Uint32 col, Uint8 a, Uint32 mask)
+{
+	Uint32 result = 0;
+	for (int shift = 0; shift < 32; shift += 8) {
+		unsigned int d = 1 + a*((col >> shift) & 0xFF) + (255-a)*((pix >> shift) & 0xFF);
+		result |= ((d + (d>>8)) >> 8) << shift;
+	}
+	return result & mask;
+}
+
+template<int XFACTOR>
+static void SpanAlpha32Run_C(Uint32* dst, const Uint8* src, int count,
+	const Uint32* pal, const Uint32* alpha, Uint32 mask)
+{
+	for (int i = 0; i < count; ++i) {
+		Uint8 p = src[i];
+		dst[XFACTOR*i] = BlendAlpha32(dst[XFACTOR*i], pal[p], (Uint8) alpha[p], mask);
+	}
+}
+
+// like TRBlender_HalfTrans
+template<int XFACTOR>
+static void SpanHalfTrans32Run_C(Uint32* dst, const Uint8* src, int count,
+	const Uint32* pal, const Uint32*, Uint32 mask)
+{
+	for (int i = 0; i < count; ++i) {
+		Uint32& pix = dst[XFACTOR*i];
+		pix = ((pal[src[i]] >> 1) & mask) + ((pix >> 1) & mask);
+	}
+}
+
+// the kernels proper, picking the loop for the direction
+#define SPAN_KERNEL(name, run) \
+static void name(Uint32* dst, int xfactor, const Uint8* src, int count, \
+	const Uint32* pal, const Uint32* alpha, Uint32 mask) \
+{ \
+	if (xfactor > 0) { \
+		run<1>(dst, src, count, pal, alpha, mask); \
+	} else { \
+		run<-1>(dst, src, count, pal, alpha, mask); \
+	} \
+}
+
+// Looks up the four pixels from i on in memory order (so backwards for
+// XFACTOR -1) and returns where they are
+template<int XFACTOR>
+SSE2_TARGET
+static inline Uint32* GatherSpan4(Uint32* dst, const Uint8* src, int i, const Uint32* table, __m128i& values)
+{
+	if (XFACTOR > 0) {
+		values = _mm_set_epi32(table[src[i+3]], table[src[i+2]], table[src[i+1]], table[src[i]]);
+		return dst + i;
+	}
+	values = _mm_set_epi32(table[src[i]], table[src[i+1]], table[src[i+2]], table[src[i+3]]);
+	return dst - i - 3;
+}
+
+// SRBlender_Alpha on eight 16 bit channels
+SSE2_TARGET
+static inline __m128i BlendAlpha16(__m128i col, __m128i pix, __m128i a)
+{
+	__m128i d = _mm_add_epi16(_mm_mullo_epi16(a, col),
+		_mm_mullo_epi16(_mm_sub_epi16(_mm_set1_epi16(255), a), pix));
+	d = _mm_add_epi16(d, _mm_set1_epi16(1));
+	return _mm_srli_epi16(_mm_add_epi16(d, _mm_srli_epi16(d, 8)), 8);
+}
+
+template<int XFACTOR>
+SSE2_TARGET
+static void SpanAlpha32Run_SSE2(Uint32* dst, const Uint8* src, int count,
+	const Uint32* pal, const Uint32* alpha, Uint32 mask)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i colorbits = _mm_set1_epi32(mask);
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i colors, alphas;
+		__m128i* pix = (__m128i*) GatherSpan4<XFACTOR>(dst, src, i, pal, colors);
+		GatherSpan4<XFACTOR>(dst, src, i, alpha, alphas);
+		__m128i old = _mm_loadu_si128(pix);
+		__m128i lo = BlendAlpha16(_mm_unpacklo_epi8(colors, zero), _mm_unpacklo_epi8(old, zero), _mm_unpacklo_epi8(alphas, zero));
+		__m128i hi = BlendAlpha16(_mm_unpackhi_epi8(colors, zero), _mm_unpackhi_epi8(old, zero), _mm_unpackhi_epi8(alphas, zero));
+		__m128i blended = _mm_and_si128(_mm_packus_epi16(lo, hi), colorbits);
+		_mm_storeu_si128(pix, blended);
+	}
+	SpanAlpha32Run_C<XFACTOR>(dst + XFACTOR*i, src + i, count - i, pal, alpha, mask);
+}
+
+template<int XFACTOR>
+SSE2_TARGET
+static void SpanHalfTrans32Run_SSE2(Uint32* dst, const Uint8* src, int count,
+	const Uint32* pal, const Uint32* alpha, Uint32 mask)
+{
+	const __m128i halfbits = _mm_set1_epi32(mask);
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i colors;
+		__m128i* pix = (__m128i*) GatherSpan4<XFACTOR>(dst, src, i, pal, colors);
+		__m128i old = _mm_loadu_si128(pix);
+		__m128i blended = _mm_add_epi32(_mm_and_si128(_mm_srli_epi32(colors, 1), halfbits),
+			_mm_and_si128(_mm_srli_epi32(old, 1), halfbits));
+		_mm_storeu_si128(pix, blended);
+	}
+	SpanHalfTrans32Run_C<XFACTOR>(dst + XFACTOR*i, src + i, count - i, pal, alpha, mask);
+}
+
+SSE2_TARGET SPAN_KERNEL(SpanAlpha32_SSE2, SpanAlpha32Run_SSE2)
+SSE2_TARGET SPAN_KERNEL(SpanHalfTrans32_SSE2, SpanHalfTrans32Run_SSE2)
+
+#undef SPAN_KERNEL
+
+#endif
+
+struct SpanKernels32 {
+	SpanKernel32 Alpha;
+	SpanKernel32 HalfTrans;
+};
+
+static SpanKernels32 SelectSpanKernels32()
+{
+	SpanKernels32 kernels = { NULL, NULL };
+#ifdef SPAN_KERNELS_SSE2
+	if (SDL_HasSSE2()) {
+		kernels.Alpha = SpanAlpha32_SSE2;
+		kernels.HalfTrans = SpanHalfTrans32_SSE2;
+	}
+#endif
+	return kernels;
+}
+
+static const SpanKernels32 spanKernels32 = SelectSpanKernels32();
+
+}
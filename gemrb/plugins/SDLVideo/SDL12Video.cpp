@@ -110,6 +110,7 @@ int SDL12VideoDriver::CreateDisplay(int w, int h, int b, bool fs, const char* ti
 	SDL_FillRect( extra, NULL, val );
 	SDL_UnlockSurface( extra );
 	SDL_FreeSurface( tmp );
+	InvalidateScreen();
 
 #ifdef VITA
 	if (width != VITA_FULLSCREEN_WIDTH || height != VITA_FULLSCREEN_HEIGHT)	{
@@ -180,6 +181,8 @@ void SDL12VideoDriver::DestroyMovieScreen()
 		SDL_FreeYUVOverlay(overlay);
 		overlay = NULL;
 	}
+	// the movie left the display black
+	InvalidateScreen();
 }
 
 void SDL12VideoDriver::showFrame(unsigned char* buf, unsigned int bufw,
@@ -231,6 +234,7 @@ bool SDL12VideoDriver::SetFullscreenMode(bool set)
 		fullscreen=set;
 		// FIXME: SDL_WM_ToggleFullScreen only works on X11. use SDL_SetVideoMode()
 		SDL_WM_ToggleFullScreen( disp );
+		InvalidateScreen();
 		//readjust mouse to original position
 		MoveMouse(CursorPos.x, CursorPos.y);
 		//synchronise internal variable
@@ -242,7 +246,20 @@ bool SDL12VideoDriver::SetFullscreenMode(bool set)
 
 int SDL12VideoDriver::SwapBuffers(void)
 {
-	SDL_BlitSurface( backBuf, NULL, disp, NULL );
+	// disp keeps the last frame, so only what changed is copied over
+	BeginUpdate();
+	if (fadeColor.a || fadePresented) {
+		// the fade covers everything, and what it covered has to be presented once it is over
+		InvalidateScreen();
+	}
+	fadePresented = fadeColor.a != 0;
+	std::vector<Region> blits(upd);
+	CoalesceRegions(blits);
+	for (size_t i = 0; i < blits.size(); i++) {
+		SDL_Rect src = RectFromRegion(blits[i]);
+		SDL_Rect dst = src;
+		SDL_BlitSurface( backBuf, &src, disp, &dst );
+	}
 	if (fadeColor.a) {
 		SDL_SetAlpha( extra, SDL_SRCALPHA, fadeColor.a );
 		SDL_Rect src = {
@@ -260,7 +277,24 @@ int SDL12VideoDriver::SwapBuffers(void)
 	int ret = SDLVideoDriver::SwapBuffers();
 	backBuf = tmp;
 
-	SDL_Flip( disp );
+	bool partial = core->PartialScreenUpdates;
+#ifdef VITA
+	// the vita port presents the whole surface either way
+	partial = false;
+#endif
+	if (partial) {
+		CoalesceRegions(upd);
+		if (!upd.empty()) {
+			std::vector<SDL_Rect> rects(upd.size());
+			for (size_t i = 0; i < upd.size(); i++) {
+				rects[i] = RectFromRegion(upd[i]);
+			}
+			SDL_UpdateRects( disp, (int) rects.size(), &rects[0] );
+		}
+	} else {
+		SDL_Flip( disp );
+	}
+	EndUpdate();
 
 	// delay before Flip can cause overwrite of display surface in the middle of gxm rendering
 	// (which may result in incomplete blit w/o mouse corsor for example)
@@ -344,6 +378,9 @@ int SDL12VideoDriver::ProcessEvent(const SDL_Event & event)
 					EvntManager->OnSpecialKeyPress( GEM_MOUSEOUT );
 			}
 			break;
+		case SDL_VIDEOEXPOSE:
+			InvalidateScreen();
+			break;
 		case SDL_JOYAXISMOTION:
 			gamepadControl.HandleAxisEvent(event.jaxis.axis, event.jaxis.value);
 		break;
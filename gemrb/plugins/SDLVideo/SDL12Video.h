@@ -30,6 +30,8 @@ private:
 	/* yuv overlay for bink movie */
 	SDL_Overlay *overlay;
 	SDL_Joystick *gameController = nullptr;
+	// whether disp still shows a faded frame
+	bool fadePresented = false;
 public:
 	SDL12VideoDriver(void);
 	~SDL12VideoDriver(void);
@@ -581,18 +581,23 @@ void GLVideoDriver::BlitGameSprite(const Sprite2D* spr, int x, int y, unsigned i
 		{
 			int trueX = cover->XPos - glSprite->XPos;
 			int trueY = cover->YPos - glSprite->YPos;
+			int parity = cover->DitherParity();
 			Uint8* data = new Uint8[glSprite->Width*glSprite->Height];
-			Uint8* coverPointer = &cover->pixels[trueY*glSprite->Width + trueX];
-			Uint8* dataPointer = data;
+			memset(data, 255, glSprite->Width*glSprite->Height);
 			for(int h=0; h<glSprite->Height; h++)
 			{
-				for(int w=0; w<glSprite->Width; w++)
+				Uint8* dataPointer = data + h*glSprite->Width;
+				int y = trueY + h;
+				for (const CoverSpan* span = cover->RowBegin(y); span != cover->RowEnd(y); ++span)
 				{
-					*dataPointer = !(*coverPointer) * 255;
-					dataPointer++;
-					coverPointer++;
+					int x0 = std::max(span->x0 - trueX, 0);
+					int x1 = std::min(span->x1 - trueX, glSprite->Width);
+					for(int w=x0; w<x1; w++)
+					{
+						if (!span->dither || SpriteCover::DitherCovers(w + trueX, y, parity))
+							dataPointer[w] = 0;
+					}
 				}
-				coverPointer += cover->Width - glSprite->Width;
 			}
 			glActiveTexture(GL_TEXTURE2);
 			glGenTextures(1, &coverTexture);
@@ -769,7 +774,10 @@ void GLVideoDriver::DrawCircle(short cx, short cy, unsigned short r, const Color
 
 int GLVideoDriver::SwapBuffers()
 {	
+	// everything is redrawn for each frame, so there is nothing to keep track of
+	BeginUpdate();
 	int val = SDLVideoDriver::SwapBuffers();
+	EndUpdate();
 	SDL_GL_SwapWindow(window);
 	paletteManager->ClearUnused(true);
 	core->RedrawAll();
@@ -816,6 +824,7 @@ void GLVideoDriver::DrawBackgroundBuffer() {
 	}
 
 	GLBlitSprite(backgroundBuffer, GLViewport, GLViewport);
+	InvalidateScreen();
 }
 
 void GLVideoDriver::FreeBackgroundBuffer() {
@@ -184,6 +184,7 @@ doneFormat:
 		return GEM_ERROR;
 	}
 	disp = backBuf;
+	InvalidateScreen();
 
 	return GEM_OK;
 }
@@ -222,6 +223,8 @@ void SDL20VideoDriver::DestroyMovieScreen()
 	// destroy any events that took place during the movies
 	SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
 	SDL_RenderClear(renderer); // I guess the videos can potentially be a larger size then the game.
+	// the new texture holds nothing yet
+	InvalidateScreen();
 }
 
 void SDL20VideoDriver::showFrame(unsigned char* buf, unsigned int bufw,
@@ -355,16 +358,37 @@ void SDL20VideoDriver::showYUVFrame(unsigned char** buf, unsigned int *strides,
 
 int SDL20VideoDriver::SwapBuffers(void)
 {
-	//this is not pretty. We make a complete copy of the backBuf into tmpBuf, then copy it back after SDLVideoDriver::SwapBuffers has blitted cursors and tooltips, and SDL_UpdateTexture has copied it to the screentexture.
-	if (Cursor[CursorIndex] && !(MouseFlags & (MOUSE_DISABLED | MOUSE_HIDDEN))) {
+	BeginUpdate();
+	//this is not pretty. We make a complete copy of the backBuf into tmpBuf, then copy the overlays back after SDLVideoDriver::SwapBuffers has blitted cursors and tooltips, and SDL_UpdateTexture has copied it to the screentexture.
+	bool overlays = core->DrawDirtyRects || (Cursor[CursorIndex] && !(MouseFlags & (MOUSE_DISABLED | MOUSE_HIDDEN)));
+	if (overlays) {
 		SDL_BlitSurface(backBuf, NULL, tmpBuf, NULL);
 	}
 	int ret = SDLVideoDriver::SwapBuffers();
 
-	SDL_UpdateTexture(screenTexture, NULL, backBuf->pixels, backBuf->pitch);
-	if (Cursor[CursorIndex] && !(MouseFlags & (MOUSE_DISABLED | MOUSE_HIDDEN))) {
-		SDL_BlitSurface(tmpBuf, NULL, backBuf, NULL);
+	if (core->PartialScreenUpdates) {
+		// the texture keeps the last frame, so only what changed is uploaded
+		CoalesceRegions(upd);
+		const int bytesPerPixel = backBuf->format->BytesPerPixel;
+		for (size_t i = 0; i < upd.size(); i++) {
+			SDL_Rect rect = RectFromRegion(upd[i]);
+			const Uint8* pixels = (const Uint8*) backBuf->pixels + rect.y * backBuf->pitch + rect.x * bytesPerPixel;
+			SDL_UpdateTexture(screenTexture, &rect, pixels, backBuf->pitch);
+		}
+		if (overlays) {
+			for (size_t i = 0; i < overlayUpd.size(); i++) {
+				SDL_Rect src = RectFromRegion(overlayUpd[i]);
+				SDL_Rect dst = src;
+				SDL_BlitSurface(tmpBuf, &src, backBuf, &dst);
+			}
+		}
+	} else {
+		SDL_UpdateTexture(screenTexture, NULL, backBuf->pixels, backBuf->pitch);
+		if (overlays) {
+			SDL_BlitSurface(tmpBuf, NULL, backBuf, NULL);
+		}
 	}
+	EndUpdate();
 	/*
 	 Commenting this out because I get better performance (on iOS) with SDL_UpdateTexture
 	 Don't know how universal it is yet so leaving this in commented out just in case
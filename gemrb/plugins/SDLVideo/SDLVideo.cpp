@@ -21,6 +21,7 @@
 #include "SDLVideo.h"
 #include "SDLSurfaceSprite2D.h"
 
+#include "BlendKernels.inl"
 #include "TileRenderer.inl"
 #include "SpriteRenderer.inl"
 
@@ -34,6 +35,8 @@
 #include "GUI/Console.h"
 #include "GUI/Window.h"
 
+#include <algorithm>
+
 #if defined(__sgi)
 #  include <math.h>
 #  ifdef __cplusplus
@@ -66,6 +69,9 @@ SDLVideoDriver::SDLVideoDriver(void)
 	lastTime = 0;
 	backBuf=NULL;
 	extra=NULL;
+	tileCache=NULL;
+	tileCacheOwner=NULL;
+	frameUpd = overlayStart = 0;
 	lastMouseDownTime = lastMouseMoveTime = GetTicks();
 	subtitlestrref = 0;
 	subtitletext = NULL;
@@ -79,6 +85,7 @@ SDLVideoDriver::~SDLVideoDriver(void)
 
 	if(backBuf) SDL_FreeSurface( backBuf );
 	if(extra) SDL_FreeSurface( extra );
+	if(tileCache) SDL_FreeSurface( tileCache );
 
 	SDL_Quit();
 
@@ -119,13 +126,14 @@ int SDLVideoDriver::SwapBuffers(void)
 	}
 
 	if (Cursor[CursorIndex] && !(MouseFlags & (MOUSE_DISABLED | MOUSE_HIDDEN))) {
-		
+		const Sprite2D* cursor = Cursor[CursorIndex];
 		if (MouseFlags&MOUSE_GRAYED) {
 			//used for greyscale blitting, fadeColor is unused
-			BlitGameSprite(Cursor[CursorIndex], CursorPos.x, CursorPos.y, BLIT_GREY, fadeColor, NULL, NULL, NULL, true);
+			BlitGameSprite(cursor, CursorPos.x, CursorPos.y, BLIT_GREY, fadeColor, NULL, NULL, NULL, true);
 		} else {
-			BlitSprite(Cursor[CursorIndex], CursorPos.x, CursorPos.y, true);
+			BlitSprite(cursor, CursorPos.x, CursorPos.y, true);
 		}
+		InvalidateRegion(Region(CursorPos.x - cursor->XPos, CursorPos.y - cursor->YPos, cursor->Width, cursor->Height));
 	}
 	if (!(MouseFlags & MOUSE_NO_TOOLTIPS)) {
 		//handle tooltips
@@ -143,9 +151,106 @@ int SDLVideoDriver::SwapBuffers(void)
 		}
 	}
 
+	if (core->DrawDirtyRects) {
+		// outline what was repainted for this frame
+		for (size_t i = 0; i < frameUpd && i < upd.size(); i++) {
+			Region r = upd[i];
+			DrawRect(r, ColorMagenta, false);
+			InvalidateRegion(Region(r.x, r.y, r.w, 1));
+			InvalidateRegion(Region(r.x, r.y + r.h - 1, r.w, 1));
+			InvalidateRegion(Region(r.x, r.y, 1, r.h));
+			InvalidateRegion(Region(r.x + r.w - 1, r.y, 1, r.h));
+		}
+	}
+	// the overlays are gone again in the next frame, so that has to present what is under them
+	if (overlayStart <= upd.size()) {
+		overlayUpd.assign(upd.begin() + overlayStart, upd.end());
+	} else {
+		overlayUpd.clear();
+	}
+
 	return PollEvents();
 }
 
+void SDLVideoDriver::InvalidateRegion(const Region& rgn)
+{
+	if (rgn.w > 0 && rgn.h > 0) {
+		upd.push_back(rgn);
+	}
+}
+
+static Region EnclosingRegion(const Region& a, const Region& b)
+{
+	int x1 = std::min(a.x, b.x);
+	int y1 = std::min(a.y, b.y);
+	int x2 = std::max(a.x + a.w, b.x + b.w);
+	int y2 = std::max(a.y + a.h, b.y + b.h);
+	return Region(x1, y1, x2 - x1, y2 - y1);
+}
+
+// Overlapping regions are merged into the region enclosing them, until none
+// overlap. Past a few dozen regions presenting them one by one costs more
+// than presenting what encloses them all.
+void SDLVideoDriver::CoalesceRegions(std::vector<Region>& regions) const
+{
+	const Region screen(0, 0, width, height);
+	size_t count = 0;
+	for (size_t i = 0; i < regions.size(); i++) {
+		Region r = regions[i].Intersect(screen);
+		if (r.w > 0 && r.h > 0) {
+			regions[count++] = r;
+		}
+	}
+	regions.resize(count);
+
+	bool merged = true;
+	while (merged) {
+		merged = false;
+		for (size_t i = 0; i < regions.size(); i++) {
+			size_t j = i + 1;
+			while (j < regions.size()) {
+				if (regions[i].IntersectsRegion(regions[j])) {
+					regions[i] = EnclosingRegion(regions[i], regions[j]);
+					regions[j] = regions.back();
+					regions.pop_back();
+					merged = true;
+				} else {
+					j++;
+				}
+			}
+		}
+	}
+
+	if (regions.size() > 32) {
+		Region all = regions[0];
+		for (size_t i = 1; i < regions.size(); i++) {
+			all = EnclosingRegion(all, regions[i]);
+		}
+		regions.assign(1, all);
+	}
+}
+
+void SDLVideoDriver::BeginUpdate()
+{
+	if (!core->PartialScreenUpdates) {
+		// present it all, in case something drew without marking it
+		InvalidateScreen();
+	}
+	CoalesceRegions(upd);
+	drawnPixels = 0;
+	for (size_t i = 0; i < upd.size(); i++) {
+		drawnPixels += (unsigned long) upd[i].w * upd[i].h;
+	}
+	frameUpd = upd.size();
+	upd.insert(upd.end(), overlayUpd.begin(), overlayUpd.end());
+	overlayStart = upd.size();
+}
+
+void SDLVideoDriver::EndUpdate()
+{
+	upd.clear();
+}
+
 int SDLVideoDriver::PollEvents()
 {
 	int ret = GEM_OK;
@@ -642,15 +747,73 @@ Sprite2D* SDLVideoDriver::CreatePalettedSprite(int w, int h, int bpp, void* pixe
 
 void SDLVideoDriver::BlitTile(const Sprite2D* spr, const Sprite2D* mask, int x, int y, const Region* clip, unsigned int flags)
 {
-	if (spr->BAM) {
-		Log(ERROR, "SDLVideo", "Tile blit not supported for this sprite");
-		return;
+	x -= Viewport.x;
+	y -= Viewport.y;
+
+	Region fClip = ClippedDrawingRect(Region(x, y, 64, 64), clip);
+	BlitTileTo(backBuf, spr, mask, x, y, fClip, flags);
+}
+
+// The tile cache is a surface in the backbuffer's format, a grid of 64x64
+// cells, so blocks of cells can be copied to the screen row by row.
+bool SDLVideoDriver::OpenTileCache(const void* owner, int columns, int rows, bool& lost)
+{
+	const SDL_PixelFormat* fmt = backBuf->format;
+	lost = owner != tileCacheOwner;
+	if (tileCache && (tileCache->w != columns * 64 || tileCache->h != rows * 64
+		|| tileCache->format->BitsPerPixel != fmt->BitsPerPixel
+		|| tileCache->format->Rmask != fmt->Rmask || tileCache->format->Gmask != fmt->Gmask
+		|| tileCache->format->Bmask != fmt->Bmask || tileCache->format->Amask != fmt->Amask)) {
+		SDL_FreeSurface(tileCache);
+		tileCache = NULL;
+	}
+	if (!tileCache) {
+		tileCache = SDL_CreateRGBSurface(SDL_SWSURFACE, columns * 64, rows * 64, fmt->BitsPerPixel,
+										 fmt->Rmask, fmt->Gmask, fmt->Bmask, fmt->Amask);
+		if (!tileCache) {
+			Log(WARNING, "SDLVideo", "Unable to create the tile cache: %s", SDL_GetError());
+			tileCacheOwner = NULL;
+			return false;
+		}
+		lost = true;
 	}
+	tileCacheOwner = owner;
+	return true;
+}
+
+void SDLVideoDriver::BlitTileCell(const Sprite2D* spr, const Sprite2D* mask, int column, int row, unsigned int flags)
+{
+	BlitTileTo(tileCache, spr, mask, column * 64, row * 64, Region(column * 64, row * 64, 64, 64), flags);
+}
 
+void SDLVideoDriver::DrawTileCells(const Region& cells, int x, int y, const Region* clip)
+{
 	x -= Viewport.x;
 	y -= Viewport.y;
 
-	Region fClip = ClippedDrawingRect(Region(x, y, 64, 64), clip);
+	Region fClip = ClippedDrawingRect(Region(x, y, cells.w * 64, cells.h * 64), clip);
+	if (fClip.w <= 0 || fClip.h <= 0) {
+		return;
+	}
+
+	int bpp = backBuf->format->BytesPerPixel;
+	const Uint8* src = (const Uint8*) tileCache->pixels
+		+ (cells.y * 64 + fClip.y - y) * tileCache->pitch + (cells.x * 64 + fClip.x - x) * bpp;
+	Uint8* dst = (Uint8*) backBuf->pixels + fClip.y * backBuf->pitch + fClip.x * bpp;
+	for (int i = 0; i < fClip.h; i++) {
+		memcpy(dst, src, fClip.w * bpp);
+		src += tileCache->pitch;
+		dst += backBuf->pitch;
+	}
+}
+
+void SDLVideoDriver::BlitTileTo(SDL_Surface* target, const Sprite2D* spr, const Sprite2D* mask,
+								int x, int y, const Region& fClip, unsigned int flags)
+{
+	if (spr->BAM) {
+		Log(ERROR, "SDLVideo", "Tile blit not supported for this sprite");
+		return;
+	}
 
 	const Uint8* data = (const Uint8*)spr->pixels;
 	const SDL_Color* pal = reinterpret_cast<const SDL_Color*>(spr->GetPaletteColors());
@@ -674,20 +837,20 @@ void SDLVideoDriver::BlitTile(const Sprite2D* spr, const Sprite2D* mask, int x,
 	}
 
 #define DO_BLIT \
-		if (backBuf->format->BytesPerPixel == 4) \
-			BlitTile_internal<Uint32>(backBuf, x, y, fClip.x - x, fClip.y - y, fClip.w, fClip.h, data, pal, mask_data, ck, T, B); \
+		if (target->format->BytesPerPixel == 4) \
+			BlitTile_internal<Uint32>(target, x, y, fClip.x - x, fClip.y - y, fClip.w, fClip.h, data, pal, mask_data, ck, T, B); \
 		else \
-			BlitTile_internal<Uint16>(backBuf, x, y, fClip.x - x, fClip.y - y, fClip.w, fClip.h, data, pal, mask_data, ck, T, B); \
+			BlitTile_internal<Uint16>(target, x, y, fClip.x - x, fClip.y - y, fClip.w, fClip.h, data, pal, mask_data, ck, T, B); \
 
 	if (flags & TILE_GREY) {
 
 		if (flags & TILE_HALFTRANS) {
-			TRBlender_HalfTrans B(backBuf->format);
+			TRBlender_HalfTrans B(target->format);
 
 			TRTinter_Grey T(tintcol);
 			DO_BLIT
 		} else {
-			TRBlender_Opaque B(backBuf->format);
+			TRBlender_Opaque B(target->format);
 
 			TRTinter_Grey T(tintcol);
 			DO_BLIT
@@ -696,12 +859,12 @@ void SDLVideoDriver::BlitTile(const Sprite2D* spr, const Sprite2D* mask, int x,
 	} else if (flags & TILE_SEPIA) {
 
 		if (flags & TILE_HALFTRANS) {
-			TRBlender_HalfTrans B(backBuf->format);
+			TRBlender_HalfTrans B(target->format);
 
 			TRTinter_Sepia T(tintcol);
 			DO_BLIT
 		} else {
-			TRBlender_Opaque B(backBuf->format);
+			TRBlender_Opaque B(target->format);
 
 			TRTinter_Sepia T(tintcol);
 			DO_BLIT
@@ -710,7 +873,7 @@ void SDLVideoDriver::BlitTile(const Sprite2D* spr, const Sprite2D* mask, int x,
 	} else {
 
 		if (flags & TILE_HALFTRANS) {
-			TRBlender_HalfTrans B(backBuf->format);
+			TRBlender_HalfTrans B(target->format);
 
 			if (tint) {
 				TRTinter_Tint T(tintcol);
@@ -720,7 +883,7 @@ void SDLVideoDriver::BlitTile(const Sprite2D* spr, const Sprite2D* mask, int x,
 				DO_BLIT
 			}
 		} else {
-			TRBlender_Opaque B(backBuf->format);
+			TRBlender_Opaque B(target->format);
 
 			if (tint) {
 				TRTinter_Tint T(tintcol);
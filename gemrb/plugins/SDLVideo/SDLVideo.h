@@ -70,7 +70,14 @@ protected:
 	// tmpBuf is here as a truly ugly hack, so we can copy backBuf to tmpBuf before blitting cursors, and then back again after the screen is presented. Only applies for SDL2.
 	SDL_Surface* tmpBuf;
 	SDL_Surface* extra;
+	// the area tiles kept between frames, see TileOverlay::Draw
+	SDL_Surface* tileCache;
+	const void* tileCacheOwner;
 	std::vector< Region> upd;//Regions of the Screen to Update in the next SwapBuffer operation.
+	// what the cursor, tooltip and dirty rect outlines covered in the last presented frame
+	std::vector< Region> overlayUpd;
+	// where in upd the regions drawn for the frame end and the overlays begin, see BeginUpdate
+	size_t frameUpd, overlayStart;
 	unsigned long lastTime;
 	unsigned long lastMouseMoveTime;
 	unsigned long lastMouseDownTime;
@@ -87,6 +94,7 @@ public:
 	virtual void SetWindowTitle(const char *title) = 0;
 	virtual bool SetFullscreenMode(bool set)=0;
 	virtual int SwapBuffers(void);
+	virtual void InvalidateRegion(const Region& rgn);
 
 	virtual bool ToggleGrabInput()=0;
 	short GetWidth() { return ( disp ? disp->w : 0 ); }
@@ -114,6 +122,9 @@ public:
 
 	virtual void BlitTile(const Sprite2D* spr, const Sprite2D* mask, int x, int y,
 						  const Region* clip, unsigned int flags);
+	virtual bool OpenTileCache(const void* owner, int columns, int rows, bool& lost);
+	virtual void BlitTileCell(const Sprite2D* spr, const Sprite2D* mask, int column, int row, unsigned int flags);
+	virtual void DrawTileCells(const Region& cells, int x, int y, const Region* clip);
 	virtual void BlitSprite(const Sprite2D* spr, int x, int y, bool anchor = false,
 							const Region* clip = NULL, Palette* palette = NULL);
 	virtual void BlitSprite(const Sprite2D* spr, const Region& src, const Region& dst, Palette* pal = NULL);
@@ -181,6 +192,14 @@ public:
 protected:
 	void DrawMovieSubtitle(ieDword strRef);
 	void BlitSurfaceClipped(SDL_Surface*, const Region& src, const Region& dst);
+	/** Merges the overlapping regions, and drops what is off screen */
+	void CoalesceRegions(std::vector<Region>& regions) const;
+	/** Starts presenting a frame: adds the last overlays to upd */
+	void BeginUpdate();
+	/** Forgets the presented regions */
+	void EndUpdate();
+	void BlitTileTo(SDL_Surface* target, const Sprite2D* spr, const Sprite2D* mask,
+					int x, int y, const Region& fClip, unsigned int flags);
 	virtual bool SetSurfaceAlpha(SDL_Surface* surface, unsigned short alpha)=0;
 	/* used to process the SDL events dequeued by PollEvents or an arbitraty event from another source.*/
 	virtual int ProcessEvent(const SDL_Event & event);
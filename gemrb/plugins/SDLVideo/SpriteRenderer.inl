@@ -292,11 +292,138 @@ struct SRBlender<Uint32, SRBlender_Alpha, SRFormat_Hard> {
 };
 
 
+// the span kernel doing what the blender does, for 32bpp targets
+template<typename Blender>
+static SpanKernel32 SRSpanKernel(const Blender&) { return NULL; }
+static SpanKernel32 SRSpanKernel(const SRBlender<Uint32, SRBlender_Alpha, SRFormat_Hard>&) { return spanKernels32.Alpha; }
+
+// below this many pixels, tinting the whole palette up front isn't worth it
+#define SPAN_MIN_PIXELS 1024
+
+// Expands the palette for the span kernels, tinted the way the per pixel
+// path would tint each pixel. The shadow index (1) is left out, the per
+// pixel path keeps drawing it, so the shadow handlers can do their thing.
+template<typename PTYPE, typename Shadow, typename Tinter, typename Blender>
+static SpanKernel32 PrepareSpanPalette(const Color* col, unsigned int flags, int pixels,
+            const Shadow& shadow, const Tinter& tint, const Blender& blend,
+            Uint32* spanpal, Uint32* spanalpha, Uint32& spanmask)
+{
+#ifdef HIGHLIGHTCOVER
+	return NULL;
+#endif
+	SpanKernel32 kernel = SRSpanKernel(blend);
+	if (!kernel || pixels < SPAN_MIN_PIXELS)
+		return NULL;
+
+	for (int p = 0; p < 256; ++p) {
+		PTYPE pix = 0;
+		int extra_alpha = 0;
+		shadow(pix, (Uint8)p, extra_alpha, flags);
+		Uint8 r = col[p].r;
+		Uint8 g = col[p].g;
+		Uint8 b = col[p].b;
+		Uint8 a = col[p].a;
+		tint(r, g, b, a, flags);
+		// over black at full alpha, the blenders just pack the colour
+		pix = 0;
+		blend(pix, r, g, b, 255);
+		spanpal[p] = pix;
+		spanalpha[p] = (a >> extra_alpha) * 0x01010101U;
+	}
+	PTYPE pix = 0;
+	blend(pix, 255, 255, 255, 255);
+	spanmask = pix;
+	return kernel;
+}
+
+
 // MSVC6 requires all template arguments to a function to be reflected in the
 // argument list. We wrap them in the type of a dummy argument.
 template <bool b>
 class MSVCHack {};
 
+// Walks the spans of a cover row in the x direction of the blit (backwards
+// for XFLIP). Besides the state of the current pixel, it tells how many
+// pixels on the state stays the same, so the blitters can skip or blend
+// whole stretches at once.
+template<bool XFLIP>
+class CoverCursor {
+public:
+	enum { UNCOVERED, DITHERED, FULL };
+
+	CoverCursor() : cover(NULL), spans(NULL), first(0), last(0), cur(0), x(0), y(0), parity(0) { }
+
+	void Init(const SpriteCover* c)
+	{
+		cover = c;
+		spans = c->RowBegin(0);
+		parity = c->DitherParity();
+	}
+
+	// moves to column col of row row
+	void Start(int row, int col)
+	{
+		y = row;
+		x = col;
+		first = (int) (cover->RowBegin(row) - spans);
+		last = (int) (cover->RowEnd(row) - spans);
+		cur = XFLIP ? last - 1 : first;
+		Seek();
+	}
+
+	void Advance(int count)
+	{
+		x += XFLIP ? -count : count;
+		Seek();
+	}
+
+	int State() const
+	{
+		if (!Inside()) return UNCOVERED;
+		return spans[cur].dither ? DITHERED : FULL;
+	}
+
+	bool Covered() const
+	{
+		if (!Inside()) return false;
+		return !spans[cur].dither || SpriteCover::DitherCovers(x, y, parity);
+	}
+
+	// the pixels from here on that are in the same state
+	int Stretch() const
+	{
+		if (!XFLIP) {
+			if (Inside()) return spans[cur].x1 - x;
+			return (cur < last ? spans[cur].x0 : cover->Width) - x;
+		}
+		if (Inside()) return x - spans[cur].x0 + 1;
+		return x + 1 - (cur >= first ? spans[cur].x1 : 0);
+	}
+
+private:
+	const SpriteCover* cover;
+	const CoverSpan* spans;
+	// cur is the first span not left of x, or the last one not right of x for XFLIP
+	int first, last, cur;
+	int x, y;
+	int parity;
+
+	bool Inside() const
+	{
+		if (!XFLIP) return cur < last && spans[cur].x0 <= x;
+		return cur >= first && spans[cur].x1 > x;
+	}
+
+	void Seek()
+	{
+		if (!XFLIP) {
+			while (cur < last && spans[cur].x1 <= x) cur++;
+		} else {
+			while (cur >= first && spans[cur].x0 > x) cur--;
+		}
+	}
+};
+
 // RLE, palette
 template<typename PTYPE, bool COVER, bool XFLIP, typename Shadow, typename Tinter, typename Blender>
 static void BlitSpriteRLE_internal(SDL_Surface* target,
@@ -315,7 +442,7 @@ static void BlitSpriteRLE_internal(SDL_Surface* target,
 	assert(spr);
 
 	int pitch = target->pitch / target->format->BytesPerPixel;
-	int coverx, covery;
+	int coverx = 0, covery = 0;
 	if (COVER) {
 		coverx = cover->XPos - spr->XPos;
 		covery = cover->YPos - spr->YPos;
@@ -339,8 +466,9 @@ static void BlitSpriteRLE_internal(SDL_Surface* target,
 
 
 	// Clipping strategy:
-	// Because we can't jump to the right spot in the RLE data,
-	// we have to process the full sprite.
+	// If the sprite is clipped, we jump to the checkpoint in the RLE data
+	// before the first visible pixel of each visible line.
+	// Without checkpoints, we have to process the full sprite.
 	// We fast-forward through the bits outside of the clipping rectangle.
 
 	// This is done line-by-line.
@@ -349,6 +477,22 @@ static void BlitSpriteRLE_internal(SDL_Surface* target,
 	// rectangle, so that we only do a single fast-forward loop followed by a
 	// blit loop.
 
+	const Uint8* rledata = srcdata;
+	const RLECheckpoint* checkpoints = NULL;
+	if (clip.x != tx || clip.y != ty || clip.w != width || clip.h != height) {
+		checkpoints = spr->GetRLECheckpoints();
+	}
+	int checkpointsPerRow = (width + RLE_CHECKPOINT_STEP - 1) / RLE_CHECKPOINT_STEP;
+	// the first visible column and row of the sprite data
+	int firstcolumn = XFLIP ? tx + width - clip.x - clip.w : clip.x - tx;
+	int row = yflip ? ty + height - clip.y - clip.h : clip.y - ty;
+	const RLECheckpoint* checkpoint = NULL;
+	int checkpointx = 0;
+	if (checkpoints) {
+		checkpoint = checkpoints + row * checkpointsPerRow + firstcolumn / RLE_CHECKPOINT_STEP;
+		checkpointx = firstcolumn - firstcolumn % RLE_CHECKPOINT_STEP;
+	}
+
 
 	PTYPE *clipstartpix, *clipendpix;
 	PTYPE *clipstartline;
@@ -361,30 +505,29 @@ static void BlitSpriteRLE_internal(SDL_Surface* target,
 
 
 	PTYPE *line, *end, *pix;
-	Uint8 *coverline, *coverpix;
+	CoverCursor<XFLIP> coverspan;
+	int coverrow = 0;
+	if (COVER)
+		coverspan.Init(cover);
+	// without checkpoints, we start at the first line of the sprite
+	if (!checkpoints) row = 0;
 	if (!yflip) {
-		line = (PTYPE*)target->pixels + ty*pitch;
+		line = (PTYPE*)target->pixels + (ty + row)*pitch;
 		end = (PTYPE*)target->pixels + (clip.y + clip.h)*pitch;
-		if (COVER)
-			coverline = (Uint8*)cover->pixels + covery*cover->Width;
+		coverrow = covery + row;
 	} else {
-		line = (PTYPE*)target->pixels + (ty + height-1)*pitch;
+		line = (PTYPE*)target->pixels + (ty + height-1 - row)*pitch;
 		end = (PTYPE*)target->pixels + (clip.y-1)*pitch;
-		if (COVER)
-			coverline = (Uint8*)cover->pixels + (covery+height-1)*cover->Width;
+		coverrow = covery + height-1 - row;
 	}
 	if (!XFLIP) {
 		pix = line + tx;
 		clipstartpix = line + clip.x;
 		clipendpix = clipstartpix + clip.w;
-		if (COVER)
-			coverpix = coverline + coverx;
 	} else {
 		pix = line + tx + width - 1;
 		clipstartpix = line + clip.x + clip.w - 1;
 		clipendpix = clipstartpix - clip.w;
-		if (COVER)
-			coverpix = coverline + coverx + width - 1;
 	}
 
 	// clipstartpix is the first pixel to draw
@@ -393,8 +536,21 @@ static void BlitSpriteRLE_internal(SDL_Surface* target,
 	const int yfactor = yflip ? -1 : 1;
 	const int xfactor = XFLIP ? -1 : 1;
 
+	Uint32 spanpal[256];
+	Uint32 spanalpha[256];
+	Uint32 spanmask = 0;
+	SpanKernel32 kernel = PrepareSpanPalette<PTYPE>(col, flags, clip.w * clip.h, shadow, tint, blend, spanpal, spanalpha, spanmask);
+
 	while (line != end) {
 
+		// Jump to the checkpoint, the run there may start before it
+		if (checkpoints) {
+			int startx = checkpointx + checkpoint->start;
+			srcdata = rledata + checkpoint->offset;
+			pix = line + (XFLIP ? tx + width - 1 - startx : tx + startx);
+			checkpoint += checkpointsPerRow;
+		}
+
 		// Fast-forward through the RLE data until we reach clipstartpix
 
 		if (!XFLIP) {
@@ -406,8 +562,6 @@ static void BlitSpriteRLE_internal(SDL_Surface* target,
 				else
 					count = 1;
 				pix += count;
-				if (COVER)
-					coverpix += count;
 			}
 		} else {
 			while (pix > clipstartpix) {
@@ -418,8 +572,6 @@ static void BlitSpriteRLE_internal(SDL_Surface* target,
 				else
 					count = 1;
 				pix -= count;
-				if (COVER)
-					coverpix -= count;
 			}
 		}
 
@@ -427,6 +579,10 @@ static void BlitSpriteRLE_internal(SDL_Surface* target,
 
 		if ((!yflip && pix >= clipstartline) || (yflip && pix < clipstartline+pitch))
 		{
+			// the cover column of the first pixel drawn
+			if (COVER)
+				coverspan.Start(coverrow, coverx + (int)(pix - line) - tx);
+
 			while ( (!XFLIP && pix < clipendpix) || (XFLIP && pix > clipendpix) )
 			{
 				Uint8 p = *srcdata++;
@@ -434,15 +590,41 @@ static void BlitSpriteRLE_internal(SDL_Surface* target,
 					int count = (int)(*srcdata++) + 1;
 					if (!XFLIP) {
 						pix += count;
-						if (COVER)
-							coverpix += count;
 					} else {
 						pix -= count;
-						if (COVER)
-							coverpix -= count;
 					}
+					if (COVER)
+						coverspan.Advance(count);
+				} else if (COVER && coverspan.State() == CoverCursor<XFLIP>::FULL) {
+					// skip the pixels hidden by the span in one go
+					const Uint8* run = srcdata - 1;
+					int left = std::min((int) (XFLIP ? pix - clipendpix : clipendpix - pix), coverspan.Stretch());
+					int count = 1;
+					while (count < left && run[count] != transindex)
+						count++;
+#ifdef HIGHLIGHTCOVER
+					for (int i = 0; i < count; ++i)
+						blend(pix[xfactor * i], 255, 255, 255, 255);
+#endif
+					srcdata = run + count;
+					pix += xfactor * count;
+					coverspan.Advance(count);
+				} else if (kernel && p != 1 && (!COVER || coverspan.State() == CoverCursor<XFLIP>::UNCOVERED)) {
+					// blend the whole run of plain pixels at once
+					const Uint8* run = srcdata - 1;
+					int left = XFLIP ? pix - clipendpix : clipendpix - pix;
+					if (COVER)
+						left = std::min(left, coverspan.Stretch());
+					int count = 1;
+					while (count < left && run[count] != transindex && run[count] != 1)
+						count++;
+					kernel((Uint32*)pix, xfactor, run, count, spanpal, spanalpha, spanmask);
+					srcdata = run + count;
+					pix += xfactor * count;
+					if (COVER)
+						coverspan.Advance(count);
 				} else {
-					if (!COVER || !*coverpix) {
+					if (!COVER || !coverspan.Covered()) {
 						int extra_alpha = 0;
 						if (!shadow(*pix, p, extra_alpha, flags)) {
 							Uint8 r = col[p].r;
@@ -459,13 +641,9 @@ static void BlitSpriteRLE_internal(SDL_Surface* target,
 					}
 #endif
 
-					if (!XFLIP) {
-						pix++;
-						if (COVER) coverpix++;
-					} else {
-						pix--;
-						if (COVER) coverpix--;
-					}
+					pix += xfactor;
+					if (COVER)
+						coverspan.Advance(1);
 				}
 			}
 		}
@@ -475,8 +653,7 @@ static void BlitSpriteRLE_internal(SDL_Surface* target,
 
 		line += yfactor * pitch;
 		pix += yfactor * pitch - xfactor * width;
-		if (COVER)
-			coverpix += yfactor * cover->Width - xfactor * width;
+		coverrow += yfactor;
 		clipstartpix += yfactor * pitch;
 		clipendpix += yfactor * pitch;
 	}
@@ -501,7 +678,7 @@ static void BlitSprite_internal(SDL_Surface* target,
 	assert(spr);
 
 	int pitch = target->pitch / target->format->BytesPerPixel;
-	int coverx, covery;
+	int coverx = 0, covery = 0;
 	if (COVER) {
 		coverx = cover->XPos - spr->XPos;
 		covery = cover->YPos - spr->YPos;
@@ -525,20 +702,21 @@ static void BlitSprite_internal(SDL_Surface* target,
 
 
 	PTYPE *line, *end;
-	Uint8 *coverpix;
+	CoverCursor<XFLIP> coverspan;
+	int coverrow, covercol;
+	if (COVER)
+		coverspan.Init(cover);
 
 	if (!yflip) {
 		line = (PTYPE*)target->pixels + clip.y*pitch;
 		end = line + clip.h*pitch;
 		srcdata += (clip.y - ty)*spr->Width;
-		if (COVER)
-			coverpix = (Uint8*)cover->pixels + (clip.y - ty + covery)*cover->Width;
+		coverrow = clip.y - ty + covery;
 	} else {
 		line = (PTYPE*)target->pixels + (clip.y + clip.h - 1)*pitch;
 		end = line - clip.h*pitch;
 		srcdata += (ty + spr->Height - (clip.y + clip.h))*spr->Width;
-		if (COVER)
-			coverpix = (Uint8*)cover->pixels + (clip.y - ty + clip.h + covery - 1)*cover->Width;
+		coverrow = clip.y - ty + clip.h + covery - 1;
 	}
 
 	PTYPE *pix, *endpix;
@@ -546,24 +724,58 @@ static void BlitSprite_internal(SDL_Surface* target,
 		pix = line + clip.x;
 		endpix = pix + clip.w;
 		srcdata += clip.x - tx;
-		if (COVER)
-			coverpix += clip.x - tx + coverx;
+		covercol = clip.x - tx + coverx;
 	} else {
 		pix = line + clip.x + clip.w - 1;
 		endpix = pix - clip.w;
 		srcdata += tx + spr->Width - (clip.x + clip.w);
-		if (COVER)
-			coverpix += clip.x - tx + clip.w + coverx - 1;
+		covercol = clip.x - tx + clip.w + coverx - 1;
 	}
 
 	const int yfactor = yflip ? -1 : 1;
 	const int xfactor = XFLIP ? -1 : 1;
 
+	Uint32 spanpal[256];
+	Uint32 spanalpha[256];
+	Uint32 spanmask = 0;
+	SpanKernel32 kernel = PrepareSpanPalette<PTYPE>(col, flags, clip.w * clip.h, shadow, tint, blend, spanpal, spanalpha, spanmask);
+
 	while (line != end) {
+		if (COVER)
+			coverspan.Start(coverrow, covercol);
 		do {
 			Uint8 p = *srcdata++;
+			if (COVER && coverspan.State() == CoverCursor<XFLIP>::FULL) {
+				// skip the pixels hidden by the span in one go
+				int count = std::min((int) (XFLIP ? pix - endpix : endpix - pix), coverspan.Stretch());
+#ifdef HIGHLIGHTCOVER
+				for (int i = 0; i < count; ++i)
+					if ((int)srcdata[i - 1] != transindex)
+						blend(pix[xfactor * i], 255, 255, 255, 255);
+#endif
+				srcdata += count - 1;
+				pix += xfactor * count;
+				coverspan.Advance(count);
+				continue;
+			}
+			if (kernel && (int)p != transindex && p != 1 && (!COVER || coverspan.State() == CoverCursor<XFLIP>::UNCOVERED)) {
+				// blend the whole run of plain pixels at once
+				const Uint8* run = srcdata - 1;
+				int left = XFLIP ? pix - endpix : endpix - pix;
+				if (COVER)
+					left = std::min(left, coverspan.Stretch());
+				int count = 1;
+				while (count < left && (int)run[count] != transindex && run[count] != 1)
+					count++;
+				kernel((Uint32*)pix, xfactor, run, count, spanpal, spanalpha, spanmask);
+				srcdata = run + count;
+				pix += xfactor * count;
+				if (COVER)
+					coverspan.Advance(count);
+				continue;
+			}
 			if ((int)p != transindex) {
-				if (!COVER || !*coverpix) {
+				if (!COVER || !coverspan.Covered()) {
 					int extra_alpha = 0;
 					if (!shadow(*pix, p, extra_alpha, flags)) {
 						Uint8 r = col[p].r;
@@ -580,13 +792,9 @@ static void BlitSprite_internal(SDL_Surface* target,
 				}
 #endif
 			}
-			if (!XFLIP) {
-				pix++;
-				if (COVER) coverpix++;
-			} else {
-				pix--;
-				if (COVER) coverpix--;
-			}
+			pix += xfactor;
+			if (COVER)
+				coverspan.Advance(1);
 		} while (pix != endpix);
 
 		// advance all pointers to the next line
@@ -594,8 +802,7 @@ static void BlitSprite_internal(SDL_Surface* target,
 		endpix += yfactor * pitch;
 		line += yfactor * pitch;
 		srcdata += (width - clip.w);
-		if (COVER)
-			coverpix += yfactor * cover->Width - xfactor * clip.w;
+		coverrow += yfactor;
 	}
 
 }
@@ -617,7 +824,7 @@ static void BlitSpriteRGB_internal(SDL_Surface* target,
 	assert(spr);
 
 	int pitch = target->pitch / target->format->BytesPerPixel;
-	int coverx, covery;
+	int coverx = 0, covery = 0;
 	if (COVER) {
 		coverx = cover->XPos - spr->XPos;
 		covery = cover->YPos - spr->YPos;
@@ -641,20 +848,21 @@ static void BlitSpriteRGB_internal(SDL_Surface* target,
 
 
 	PTYPE *line, *end;
-	Uint8 *coverpix;
+	CoverCursor<XFLIP> coverspan;
+	int coverrow, covercol;
+	if (COVER)
+		coverspan.Init(cover);
 
 	if (!yflip) {
 		line = (PTYPE*)target->pixels + clip.y*pitch;
 		end = line + clip.h*pitch;
 		srcdata += (clip.y - ty)*spr->Width;
-		if (COVER)
-			coverpix = (Uint8*)cover->pixels + (clip.y - ty + covery)*cover->Width;
+		coverrow = clip.y - ty + covery;
 	} else {
 		line = (PTYPE*)target->pixels + (clip.y + clip.h - 1)*pitch;
 		end = line - clip.h*pitch;
 		srcdata += (ty + spr->Height - (clip.y + clip.h))*spr->Width;
-		if (COVER)
-			coverpix = (Uint8*)cover->pixels + (clip.y - ty + clip.h + covery - 1)*cover->Width;
+		coverrow = clip.y - ty + clip.h + covery - 1;
 	}
 
 	PTYPE *pix, *endpix;
@@ -662,25 +870,38 @@ static void BlitSpriteRGB_internal(SDL_Surface* target,
 		pix = line + clip.x;
 		endpix = pix + clip.w;
 		srcdata += clip.x - tx;
-		if (COVER)
-			coverpix += clip.x - tx + coverx;
+		covercol = clip.x - tx + coverx;
 	} else {
 		pix = line + clip.x + clip.w - 1;
 		endpix = pix - clip.w;
 		srcdata += tx + spr->Width - (clip.x + clip.w);
-		if (COVER)
-			coverpix += clip.x - tx + clip.w + coverx - 1;
+		covercol = clip.x - tx + clip.w + coverx - 1;
 	}
 
 	const int yfactor = yflip ? -1 : 1;
 	const int xfactor = XFLIP ? -1 : 1;
 
 	while (line != end) {
+		if (COVER)
+			coverspan.Start(coverrow, covercol);
 		do {
+			if (COVER && coverspan.State() == CoverCursor<XFLIP>::FULL) {
+				// skip the pixels hidden by the span in one go
+				int count = std::min((int) (XFLIP ? pix - endpix : endpix - pix), coverspan.Stretch());
+#ifdef HIGHLIGHTCOVER
+				for (int i = 0; i < count; ++i)
+					if (srcdata[i] >> 24)
+						blend(pix[xfactor * i], 255, 255, 255, 255);
+#endif
+				srcdata += count;
+				pix += xfactor * count;
+				coverspan.Advance(count);
+				continue;
+			}
 			Uint32 p = *srcdata++;
 			Uint8 a = (Uint8)(p >> 24);
 			if (a != 0) {
-				if (!COVER || !*coverpix) {
+				if (!COVER || !coverspan.Covered()) {
 					Uint8 r = (Uint8)(p);
 					Uint8 g = (Uint8)(p >> 8);
 					Uint8 b = (Uint8)(p >> 16);
@@ -693,13 +914,9 @@ static void BlitSpriteRGB_internal(SDL_Surface* target,
 				}
 #endif
 			}
-			if (!XFLIP) {
-				pix++;
-				if (COVER) coverpix++;
-			} else {
-				pix--;
-				if (COVER) coverpix--;
-			}
+			pix += xfactor;
+			if (COVER)
+				coverspan.Advance(1);
 		} while (pix != endpix);
 
 		// advance all pointers to the next line
@@ -707,8 +924,7 @@ static void BlitSpriteRGB_internal(SDL_Surface* target,
 		endpix += yfactor * pitch;
 		line += yfactor * pitch;
 		srcdata += (width - clip.w);
-		if (COVER)
-			coverpix += yfactor * cover->Width - xfactor * clip.w;
+		coverrow += yfactor;
 	}
 
 }
@@ -89,6 +89,18 @@ struct TRBlender_HalfTrans {
 	Uint32 mask;
 };
 
+// the span kernel doing what the blender does, for 32bpp targets
+static SpanKernel32 TRSpanKernel(const TRBlender_Opaque&, Uint32&)
+{
+	return NULL;
+}
+
+static SpanKernel32 TRSpanKernel(const TRBlender_HalfTrans& blend, Uint32& mask)
+{
+	mask = blend.mask;
+	return spanKernels32.HalfTrans;
+}
+
 
 //the dummy variable is a hint for MSVC6, otherwise it compiles bad code
 //because it cannot select between the 16 and 32 bit variants
@@ -137,13 +149,23 @@ static void BlitTile_internal(SDL_Surface* target,
 
 	} else {
 
+		SpanKernel32 kernel = NULL;
+		Uint32 kernelmask = 0;
+		if (sizeof(PixelType) == 4) {
+			kernel = TRSpanKernel(blend, kernelmask);
+		}
+
 		for (int y = 0; y < h; ++y) {
 			PixelType* buf = buf_line + tx + rx;
 			data = data_line + rx;
-			for (int x = 0; x < w; ++x) {
-				Uint8 p = *data++;
-				*buf = (PixelType)blend(opal[p],*buf);
-				buf++;
+			if (kernel) {
+				kernel((Uint32*)buf, 1, data, w, (const Uint32*)opal, NULL, kernelmask);
+			} else {
+				for (int x = 0; x < w; ++x) {
+					Uint8 p = *data++;
+					*buf = (PixelType)blend(opal[p],*buf);
+					buf++;
+				}
 			}
 			buf_line += target->pitch / sizeof(PixelType);
 			data_line += 64;
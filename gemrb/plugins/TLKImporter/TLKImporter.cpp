@@ -28,9 +28,20 @@
 #include "TableMgr.h"
 #include "GUI/GameControl.h"
 #include "Scriptable/Actor.h"
+#include "System/FileStream.h"
+#if defined(SUPPORTS_MEMSTREAM)
+#include "System/MappedFileMemoryStream.h"
+#endif
 
 using namespace GemRB;
 
+// size of one entry in the string table
+#define TLK_ENTRY_SIZE 0x1A
+// how many decoded strings we keep around
+#define TLK_CACHE_SIZE 1024
+// the flags that change the returned text (the rest only affect the sound)
+#define TLK_CACHE_FLAGS (IE_STR_STRREFON | IE_STR_REMOVE_NEWLINE)
+
 struct gt_type
 {
 	int type;
@@ -71,6 +82,7 @@ static void ReleaseGtEntry(void *poi)
 
 TLKImporter::~TLKImporter(void)
 {
+	ClearDecoded();
 	delete str;
 	
 	gtmap.RemoveAll(ReleaseGtEntry);
@@ -86,6 +98,16 @@ void TLKImporter::CloseAux()
 	OverrideTLK = NULL;
 }
 
+void TLKImporter::ClearDecoded()
+{
+	const char* key;
+	void* value;
+	while (decoded.getLRU(0, key, value)) {
+		free(value);
+		decoded.Remove(key);
+	}
+}
+
 void TLKImporter::OpenAux()
 {
 	CloseAux();
@@ -101,8 +123,22 @@ bool TLKImporter::Open(DataStream* stream)
 	if (stream == NULL) {
 		return false;
 	}
+	ClearDecoded();
+	entries = NULL;
 	delete str;
 	str = stream;
+#if defined(SUPPORTS_MEMSTREAM)
+	// map the whole file, so the entry table and the text can be used in place
+	if (dynamic_cast<FileStream*>(str) && str->originalfile[0]) {
+		MappedFileMemoryStream* mapped = new MappedFileMemoryStream{str->originalfile};
+		if (mapped->isOk()) {
+			delete str;
+			str = mapped;
+		} else {
+			delete mapped;
+		}
+	}
+#endif
 	char Signature[8];
 	str->Read( Signature, 8 );
 	if (strncmp( Signature, "TLK\x20V1\x20\x20", 8 ) != 0) {
@@ -116,6 +152,11 @@ bool TLKImporter::Open(DataStream* stream)
 		Log(ERROR, "TLKImporter", "Too many strings (%d), increase STRREF_START.", StrRefCount);
 		return false;
 	}
+	entries = str->ReadSpan(StrRefCount * TLK_ENTRY_SIZE, entryStorage);
+	if (!entries) {
+		Log(ERROR, "TLKImporter", "Cannot read the string table.");
+		return false;
+	}
 	return true;
 }
 
@@ -388,6 +429,18 @@ String* TLKImporter::GetString(ieStrRef strref, ieDword flags)
 	return string;
 }
 
+// the sound resref of a string table entry, same normalisation as ReadResRef
+static void EntrySoundRef(const char* entry, ieResRef dest)
+{
+	for (int i = 0; i < 8; i++) {
+		dest[i] = (char) tolower(entry[2 + i]);
+	}
+	for (int i = 7; i >= 0 && dest[i] == ' '; i--) {
+		dest[i] = 0;
+	}
+	dest[8] = 0;
+}
+
 char* TLKImporter::GetCString(ieStrRef strref, ieDword flags)
 {
 	char* string;
@@ -395,6 +448,8 @@ char* TLKImporter::GetCString(ieStrRef strref, ieDword flags)
 	ieWord type;
 	int Length;
 	ieResRef SoundResRef;
+	char cacheKey[24];
+	bool cacheable = false;
 
 	if (empty || strref >= STRREF_START || (strref >= BIO_START && strref <= BIO_END)) {
 		if (OverrideTLK) {
@@ -407,18 +462,25 @@ char* TLKImporter::GetCString(ieStrRef strref, ieDword flags)
 		type = 0;
 		SoundResRef[0]=0;
 	} else {
-		ieDword Volume, Pitch, StrOffset;
-		ieDword l;
-		if (str->Seek( 18 + ( strref * 0x1A ), GEM_STREAM_START ) == GEM_ERROR) {
+		if (strref >= StrRefCount) {
 			return strdup("");
 		}
-		str->ReadWord( &type );
-		str->ReadResRef( SoundResRef );
+		const char* entry = entries + strref * TLK_ENTRY_SIZE;
+		type = DataStream::WordAt(entry);
+		EntrySoundRef(entry, SoundResRef);
 		// volume and pitch variance fields are known to be unused at minimum in bg1
-		str->ReadDword( &Volume );
-		str->ReadDword( &Pitch );
-		str->ReadDword( &StrOffset );
-		str->ReadDword( &l );
+		ieDword StrOffset = DataStream::DwordAt(entry + 18);
+		ieDword l = DataStream::DwordAt(entry + 22);
+
+		snprintf(cacheKey, sizeof(cacheKey), "%u:%u", strref, flags & TLK_CACHE_FLAGS);
+		void* cached;
+		if (decoded.Lookup(cacheKey, cached)) {
+			decoded.Touch(cacheKey);
+			string = strdup((const char *) cached);
+			goto play_sound;
+		}
+		cacheable = true;
+
 		if (l > 65535) {
 			Length = 65535; //safety limit, it could be a dword actually
 		}
@@ -427,9 +489,18 @@ char* TLKImporter::GetCString(ieStrRef strref, ieDword flags)
 		}
 		
 		if (type & 1) {
-			str->Seek( StrOffset + Offset, GEM_STREAM_START );
 			string = ( char * ) malloc( Length + 1 );
-			str->Read( string, Length );
+			const char* text = NULL;
+			if (str->Seek( StrOffset + Offset, GEM_STREAM_START ) != GEM_ERROR) {
+				std::vector<char> storage;
+				text = str->ReadSpan( Length, storage );
+				if (text) {
+					memcpy( string, text, Length );
+				}
+			}
+			if (!text) {
+				Length = 0;
+			}
 		} else {
 			Length = 0;
 			string = ( char * ) malloc( 1 );
@@ -439,6 +510,11 @@ char* TLKImporter::GetCString(ieStrRef strref, ieDword flags)
 
 	//tagged text, bg1 and iwd don't mark them specifically, all entries are tagged
 	if (core->HasFeature( GF_ALL_STRINGS_TAGGED ) || ( type & 4 )) {
+		// tokens depend on the game state, so don't remember the result
+		// voice actor directives are just dropped, those are fine
+		if (strchr(string, '<')) {
+			cacheable = false;
+		}
 		//GetNewStringLength will look in string and return true
 		//if the new Length will change due to tokens
 		//if there is no new length, we are done
@@ -450,21 +526,32 @@ char* TLKImporter::GetCString(ieStrRef strref, ieDword flags)
 			string = string2;
 		}
 	}
-	if (type & 2 && flags & IE_STR_SOUND && SoundResRef[0] != 0) {
-		// GEM_SND_SPEECH will stop the previous sound source
-		unsigned int flag = GEM_SND_RELATIVE | (flags & (GEM_SND_SPEECH | GEM_SND_QUEUE));
-		core->GetAudioDrv()->Play(SoundResRef, SFX_CHAN_DIALOG, 0, 0, flag);
-	}
 	if (flags & IE_STR_STRREFON) {
 		char* string2 = ( char* ) malloc( Length + 13 );
 		snprintf(string2, Length + 13, "%u: %s", strref, string);
 		free( string );
-		return string2;
-	}
-	// remove the linefeed and carriage return if requested
-	if (flags & IE_STR_REMOVE_NEWLINE) {
+		string = string2;
+	} else if (flags & IE_STR_REMOVE_NEWLINE) {
+		// remove the linefeed and carriage return if requested
 		core->StripLine( string, Length);
 	}
+	if (cacheable) {
+		decoded.SetAt(cacheKey, strdup(string));
+		if (decoded.GetCount() > TLK_CACHE_SIZE) {
+			const char* key;
+			void* value;
+			decoded.getLRU(0, key, value);
+			free(value);
+			decoded.Remove(key);
+		}
+	}
+
+	play_sound:
+	if (type & 2 && flags & IE_STR_SOUND && SoundResRef[0] != 0) {
+		// GEM_SND_SPEECH will stop the previous sound source
+		unsigned int flag = GEM_SND_RELATIVE | (flags & (GEM_SND_SPEECH | GEM_SND_QUEUE));
+		core->GetAudioDrv()->Play(SoundResRef, SFX_CHAN_DIALOG, 0, 0, flag);
+	}
 	return string;
 }
 
@@ -480,11 +567,8 @@ StringBlock TLKImporter::GetStringBlock(ieStrRef strref, unsigned int flags)
 	if (empty || strref >= StrRefCount) {
 		return StringBlock();
 	}
-	ieWord type;
-	str->Seek( 18 + ( strref * 0x1A ), GEM_STREAM_START );
-	str->ReadWord( &type );
 	ieResRef soundRef;
-	str->ReadResRef( soundRef );
+	EntrySoundRef(entries + strref * TLK_ENTRY_SIZE, soundRef);
 	return StringBlock(GetString( strref, flags ), soundRef);
 }
 
@@ -23,9 +23,12 @@
 
 
 #include "StringMgr.h"
+#include "LRUCache.h"
 #include "Variables.h"
 #include "TlkOverride.h"
 
+#include <vector>
+
 namespace GemRB {
 
 class TLKImporter : public StringMgr {
@@ -36,6 +39,11 @@ private:
 	ieWord Language = 0;
 	ieDword StrRefCount = 0;
 	ieDword Offset = 0;
+	/** view of the entry table; points into str if it is memory backed */
+	const char* entries = nullptr;
+	std::vector<char> entryStorage;
+	/** decoded strings that do not depend on game state */
+	LRUCache decoded;
 	CTlkOverride *OverrideTLK = nullptr;
 	Variables gtmap;
 	int charname = 0;
@@ -72,6 +80,7 @@ private:
 	int GenderStrRef(int slot, int malestrref, int femalestrref);
 	char *Gabber() const;
 	char *CharName(int slot) const;
+	void ClearDecoded();
 };
 
 }
@@ -0,0 +1,175 @@
+/* GemRB - Infinity Engine Emulator
+ * Copyright (C) 2021 The GemRB Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ *
+ */
+
+// Checks that the span kernels of the SDL video driver give exactly the
+// pixels of the per pixel blenders they stand in for, in both blit
+// directions and for every run length up to a few groups of four.
+
+#include "RGBAColor.h"
+#include "Sprite2D.h"
+#include "Video.h"
+
+#include <SDL.h>
+#include <cstdio>
+#include <cstdlib>
+
+#include "BlendKernels.inl"
+#include "TileRenderer.inl"
+#include "SpriteRenderer.inl"
+
+using namespace GemRB;
+
+static const int MAX_RUN = 19;
+static const int ROUNDS = 2000;
+
+static Uint32 RandomPixel()
+{
+	return ((Uint32) (rand() & 0xFFFF) << 16) | (Uint32) (rand() & 0xFFFF);
+}
+
+// SRBlender_Alpha, as the sprite renderers blend a palette with its own alpha
+static int CheckAlpha(SpanKernel32 kernel)
+{
+	SRShadow_NOP shadow;
+	SRTinter_NoTint<true> tint;
+	SRBlender<Uint32, SRBlender_Alpha, SRFormat_Hard> blend;
+	Color col[256];
+	Uint32 spanpal[256], spanalpha[256], spanmask;
+	Uint8 src[MAX_RUN];
+	Uint32 expected[MAX_RUN + 2], actual[MAX_RUN + 2];
+	int failures = 0;
+
+	for (int round = 0; round < ROUNDS; ++round) {
+		for (int p = 0; p < 256; ++p) {
+			col[p].r = rand() & 0xFF;
+			col[p].g = rand() & 0xFF;
+			col[p].b = rand() & 0xFF;
+			col[p].a = rand() & 0xFF;
+		}
+		// the edge alphas are the likeliest to round differently
+		col[rand() & 0xFF].a = 0;
+		col[rand() & 0xFF].a = 255;
+		if (!PrepareSpanPalette<Uint32>(col, 0, SPAN_MIN_PIXELS, shadow, tint, blend, spanpal, spanalpha, spanmask)) {
+			fprintf(stderr, "no alpha span kernel for the 32bpp blender\n");
+			return 1;
+		}
+
+		for (int count = 1; count <= MAX_RUN; ++count) {
+			for (int xfactor = -1; xfactor <= 1; xfactor += 2) {
+				for (int i = 0; i < count; ++i) {
+					src[i] = rand() & 0xFF;
+				}
+				for (int i = 0; i < MAX_RUN + 2; ++i) {
+					expected[i] = actual[i] = RandomPixel();
+				}
+				// one pixel of slack on either side, to catch stray writes
+				int start = xfactor > 0 ? 1 : count;
+				for (int i = 0; i < count; ++i) {
+					Color c = col[src[i]];
+					tint(c.r, c.g, c.b, c.a, 0);
+					blend(expected[start + xfactor * i], c.r, c.g, c.b, c.a);
+				}
+				kernel(actual + start, xfactor, src, count, spanpal, spanalpha, spanmask);
+				for (int i = 0; i < MAX_RUN + 2; ++i) {
+					if (expected[i] != actual[i]) {
+						fprintf(stderr, "alpha: run of %d, xfactor %d, pixel %d: %08x instead of %08x\n",
+							count, xfactor, i, actual[i], expected[i]);
+						failures++;
+					}
+				}
+			}
+		}
+	}
+	return failures;
+}
+
+// TRBlender_HalfTrans, as the tile renderer blends unmasked tiles
+static int CheckHalfTrans(SpanKernel32 kernel, const SDL_PixelFormat* format)
+{
+	TRBlender_HalfTrans blend(format);
+	Uint32 kernelmask = 0;
+	if (TRSpanKernel(blend, kernelmask) != kernel) {
+		fprintf(stderr, "the tile renderer doesn't use the halftrans span kernel\n");
+		return 1;
+	}
+	Uint32 opal[256];
+	Uint8 src[MAX_RUN];
+	Uint32 expected[MAX_RUN + 2], actual[MAX_RUN + 2];
+	int failures = 0;
+
+	for (int round = 0; round < ROUNDS; ++round) {
+		for (int p = 0; p < 256; ++p) {
+			opal[p] = RandomPixel();
+		}
+		for (int count = 1; count <= MAX_RUN; ++count) {
+			for (int xfactor = -1; xfactor <= 1; xfactor += 2) {
+				for (int i = 0; i < count; ++i) {
+					src[i] = rand() & 0xFF;
+				}
+				for (int i = 0; i < MAX_RUN + 2; ++i) {
+					expected[i] = actual[i] = RandomPixel();
+				}
+				int start = xfactor > 0 ? 1 : count;
+				for (int i = 0; i < count; ++i) {
+					Uint32& pix = expected[start + xfactor * i];
+					pix = blend(opal[src[i]], pix);
+				}
+				kernel(actual + start, xfactor, src, count, opal, NULL, kernelmask);
+				for (int i = 0; i < MAX_RUN + 2; ++i) {
+					if (expected[i] != actual[i]) {
+						fprintf(stderr, "halftrans: run of %d, xfactor %d, pixel %d: %08x instead of %08x\n",
+							count, xfactor, i, actual[i], expected[i]);
+						failures++;
+					}
+				}
+			}
+		}
+	}
+	return failures;
+}
+
+int main()
+{
+	if (!spanKernels32.Alpha || !spanKernels32.HalfTrans) {
+		fprintf(stderr, "no span kernels on this cpu, the per pixel blenders are used\n");
+		return 0;
+	}
+	srand(4242);
+
+	// the 888 target format of the renderers
+	SDL_PixelFormat format = SDL_PixelFormat();
+	format.BitsPerPixel = 32;
+	format.BytesPerPixel = 4;
+	format.Rshift = RSHIFT32;
+	format.Gshift = GSHIFT32;
+	format.Bshift = BSHIFT32;
+
+	// opaque tiles are left to the per pixel loop
+	TRBlender_Opaque opaque(&format);
+	Uint32 opaquemask = 0;
+	int failures = TRSpanKernel(opaque, opaquemask) != NULL;
+	failures += CheckAlpha(spanKernels32.Alpha);
+	failures += CheckHalfTrans(spanKernels32.HalfTrans, &format);
+	if (failures) {
+		fprintf(stderr, "%d pixels differ\n", failures);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,208 @@
+/* GemRB - Infinity Engine Emulator
+ * Copyright (C) 2021 The GemRB Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ *
+ */
+
+// Property test of SearchmapView::GetBlockedInLine, the cell by cell line
+// walker, against the sampled walker it replaced and a dense reference that
+// follows the segment in 1/64 pixel steps. Blocking one searchmap cell at a
+// time tells which cells a walker looked at:
+// - the walker sees every cell the dense reference passes through,
+// - it sees no cell the segment doesn't touch (corners included),
+// - and it sees every cell the sampled walker saw, except where the
+//   sampled points had drifted off the segment.
+// Both the line of sight (sidewalls, going on) and the walkability (stopping
+// at the first impassable cell) variants are checked.
+
+#include "Map.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+
+using namespace GemRB;
+
+static const int WIDTH = 40; // cells, 640 pixels
+static const int HEIGHT = 50; // cells, 600 pixels
+static const int SEGMENTS = 5000;
+
+typedef std::set<int> CellSet;
+
+static inline long FloorDiv(long a, long b)
+{
+	return a >= 0 ? a / b : (a - b + 1) / b;
+}
+
+// the cells the points of the segment lie in, in 1/64 pixel steps
+static CellSet DenseCells(const Point &s, const Point &d)
+{
+	CellSet cells;
+	long dx = d.x - s.x;
+	long dy = d.y - s.y;
+	long steps = 64 * std::max(std::abs(dx), std::abs(dy));
+	for (long k = 0; k <= steps; k++) {
+		long x = FloorDiv(s.x * steps + dx * k, 16 * steps);
+		long y = FloorDiv(s.y * steps + dy * k, 12 * steps);
+		cells.insert(y * WIDTH + x);
+	}
+	return cells;
+}
+
+// whether the segment touches the closed rectangle of the cell
+static bool TouchesCell(const Point &s, const Point &d, int cell)
+{
+	long x0 = (cell % WIDTH) * 16, x1 = x0 + 16;
+	long y0 = (cell / WIDTH) * 12, y1 = y0 + 12;
+	if (std::max(s.x, d.x) < x0 || std::min(s.x, d.x) > x1 || std::max(s.y, d.y) < y0 || std::min(s.y, d.y) > y1) {
+		return false;
+	}
+	long dx = d.x - s.x;
+	long dy = d.y - s.y;
+	int below = 0, above = 0;
+	const long cornersX[4] = { x0, x1, x0, x1 };
+	const long cornersY[4] = { y0, y0, y1, y1 };
+	for (int i = 0; i < 4; i++) {
+		long cross = dx * (cornersY[i] - s.y) - dy * (cornersX[i] - s.x);
+		if (cross < 0) below++;
+		if (cross > 0) above++;
+	}
+	return below < 4 && above < 4;
+}
+
+struct Walkers {
+	unsigned short cells[WIDTH * HEIGHT];
+	SearchmapView view;
+
+	Walkers()
+	{
+		std::fill(cells, cells + WIDTH * HEIGHT, (unsigned short) PATH_MAP_PASSABLE);
+		view.cells = cells;
+		view.width = WIDTH;
+		view.height = HEIGHT;
+	}
+
+	// the cells that, blocked alone, make the walker report the block
+	CellSet Seen(const Point &s, const Point &d, bool sampled, bool walk)
+	{
+		CellSet seen;
+		int minX = std::max(0, std::min(s.x, d.x) / 16 - 1);
+		int maxX = std::min(WIDTH - 1, std::max(s.x, d.x) / 16 + 1);
+		int minY = std::max(0, std::min(s.y, d.y) / 12 - 1);
+		int maxY = std::min(HEIGHT - 1, std::max(s.y, d.y) / 12 + 1);
+		for (int y = minY; y <= maxY; y++) {
+			for (int x = minX; x <= maxX; x++) {
+				unsigned short &cell = cells[y * WIDTH + x];
+				cell = walk ? PATH_MAP_IMPASSABLE : PATH_MAP_SIDEWALL;
+				unsigned int ret;
+				if (sampled) {
+					ret = view.GetBlockedInSampledLine(s, d, walk, 1);
+				} else {
+					ret = view.GetBlockedInLine(s, d, walk, 1);
+				}
+				if (walk ? !ret : (ret & PATH_MAP_SIDEWALL)) {
+					seen.insert(y * WIDTH + x);
+				}
+				cell = PATH_MAP_PASSABLE;
+			}
+		}
+		return seen;
+	}
+};
+
+static Point RandomPoint()
+{
+	return Point(rand() % (WIDTH * 16), rand() % (HEIGHT * 12));
+}
+
+// random segments up to 200 pixels, plus ones along the axes, along cell
+// borders and through cell corners
+static void RandomSegment(Point &s, Point &d)
+{
+	s = RandomPoint();
+	switch (rand() % 4) {
+		case 0:
+			d = Point(s.x + rand() % 401 - 200, s.y + rand() % 401 - 200);
+			break;
+		case 1:
+			d = rand() % 2 ? Point(s.x, s.y + rand() % 401 - 200) : Point(s.x + rand() % 401 - 200, s.y);
+			break;
+		case 2:
+			s = Point(s.x / 16 * 16, s.y / 12 * 12);
+			d = Point(s.x + (rand() % 13 - 6) * 16, s.y + (rand() % 17 - 8) * 12);
+			break;
+		default:
+			{
+				int k = rand() % 9 - 4;
+				int cx = rand() % 5 - 2, cy = rand() % 5 - 2;
+				d = Point(s.x + k * 16 * cx, s.y + k * 12 * cy);
+			}
+			break;
+	}
+	d.x = std::min(std::max((int) d.x, 0), WIDTH * 16 - 1);
+	d.y = std::min(std::max((int) d.y, 0), HEIGHT * 12 - 1);
+}
+
+static void Report(const char *what, const Point &s, const Point &d, bool walk, int cell)
+{
+	fprintf(stderr, "%s: (%d, %d) to (%d, %d), %s, cell (%d, %d)\n", what, s.x, s.y, d.x, d.y,
+		walk ? "walkability" : "line of sight", cell % WIDTH, cell / WIDTH);
+}
+
+int main()
+{
+	srand(1616);
+	Walkers walkers;
+	int failures = 0;
+
+	for (int i = 0; i < SEGMENTS; i++) {
+		Point s, d;
+		RandomSegment(s, d);
+		if (s == d) {
+			continue;
+		}
+		CellSet dense = DenseCells(s, d);
+		for (int walk = 0; walk < 2; walk++) {
+			CellSet seen = walkers.Seen(s, d, false, walk);
+			CellSet sampled = walkers.Seen(s, d, true, walk);
+			for (CellSet::const_iterator it = dense.begin(); it != dense.end(); ++it) {
+				if (!seen.count(*it)) {
+					Report("missed a cell of the segment", s, d, walk, *it);
+					failures++;
+				}
+			}
+			for (CellSet::const_iterator it = seen.begin(); it != seen.end(); ++it) {
+				if (!TouchesCell(s, d, *it)) {
+					Report("saw a cell off the segment", s, d, walk, *it);
+					failures++;
+				}
+			}
+			for (CellSet::const_iterator it = sampled.begin(); it != sampled.end(); ++it) {
+				if (!seen.count(*it) && TouchesCell(s, d, *it)) {
+					Report("missed a cell the sampled walker saw", s, d, walk, *it);
+					failures++;
+				}
+			}
+		}
+	}
+
+	if (failures) {
+		fprintf(stderr, "%d cells differ\n", failures);
+		return 1;
+	}
+	return 0;
+}